@@ -0,0 +1,57 @@
+#include "pch.h"
+#include "ConnectBackend.h"
+#include "DualStackConnector.h"
+
+#include <algorithm>
+
+using namespace InetSpeedUWP;
+using namespace Concurrency;
+using namespace Platform;
+using namespace Windows::Networking;
+
+const long long connection_attempt_delay_ms = 250;
+const long long min_connection_attempt_delay_ms = 10;
+
+namespace
+{
+	AddressFamily ToAddressFamily(HostNameType type)
+	{
+		return type == HostNameType::Ipv4 ? AddressFamily::Ipv4 : type == HostNameType::Ipv6 ? AddressFamily::Ipv6 : AddressFamily::Unknown;
+	}
+}
+
+task<ConnectSample> StreamSocketBackend::Connect(const std::wstring& hostName, const std::wstring& serviceName, cancellation_token token, std::chrono::milliseconds timeout)
+{
+	HostName^ host;
+	try
+	{
+		host = ref new HostName(ref new String(hostName.c_str(), static_cast<unsigned int>(hostName.size())));
+	}
+	catch (Platform::COMException^ e) //not a valid host name, fail the probe rather than the caller...
+	{
+		return task_from_exception<ConnectSample>(e);
+	}
+	auto service = ref new String(serviceName.c_str(), static_cast<unsigned int>(serviceName.size()));
+
+	//a tight timeout must still leave the second address family time to answer...
+	auto attemptDelay = std::min(std::chrono::milliseconds(connection_attempt_delay_ms), std::max(timeout / 2, std::chrono::milliseconds(min_connection_attempt_delay_ms)));
+	DualStackConnector connector(attemptDelay);
+
+	return connector.Connect(host, service, token, timeout).then([](DualStackConnection connection)
+	{
+		ConnectSample sample = { 0.0, ToAddressFamily(connection.Family), connection.DnsLatency, connection.ConnectTime };
+		try
+		{
+			//right after the handshake the stack has a single RTT sample, so Max and Variance add nothing to Min...
+			sample.Rtt = connection.Socket->Information->RoundTripTimeStatistics.Min / 1000000.0;
+		}
+		catch (...)
+		{
+			delete connection.Socket;
+			throw;
+		}
+
+		delete connection.Socket;
+		return sample;
+	});
+}
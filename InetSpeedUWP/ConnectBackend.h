@@ -0,0 +1,47 @@
+#pragma once
+#include "pch.h"
+
+#include <chrono>
+#include <string>
+
+namespace InetSpeedUWP
+{
+	enum class AddressFamily
+	{
+		Unknown,
+		Ipv4,
+		Ipv6
+	};
+
+	// What one successful connect yields, all times in seconds: the handshake RTT the stack measured on the
+	// connection, the address family that connected, the time spent resolving the name beforehand (0 if it was
+	// cached), and the wall-clock time the connect took as seen from user space. ConnectTime - Rtt is the timing
+	// error a user-space stopwatch would have added.
+	struct ConnectSample
+	{
+		double Rtt;
+		AddressFamily Family;
+		double DnsLatency;
+		double ConnectTime;
+	};
+
+	// Socket layer used by ProbeEngine. The engine only schedules probes, applies timeouts and collects samples;
+	// how a connect is made and where its RTT comes from is up to the backend. Connect fails with task_canceled
+	// when the token is cancelled or the timeout expires, and with the platform's error otherwise.
+	// The interface uses no WinRT types, so a backend over another socket API can implement it as is.
+	class ConnectBackend
+	{
+	public:
+		virtual ~ConnectBackend() {}
+
+		virtual concurrency::task<ConnectSample> Connect(const std::wstring& hostName, const std::wstring& serviceName, concurrency::cancellation_token token, std::chrono::milliseconds timeout) = 0;
+	};
+
+	// Default backend: StreamSocket connects raced across address families by DualStackConnector, with the RTT
+	// taken from the socket's RoundTripTimeStatistics.
+	class StreamSocketBackend : public ConnectBackend
+	{
+	public:
+		virtual concurrency::task<ConnectSample> Connect(const std::wstring& hostName, const std::wstring& serviceName, concurrency::cancellation_token token, std::chrono::milliseconds timeout) override;
+	};
+}
@@ -0,0 +1,181 @@
+#include "pch.h"
+#include "DualStackConnector.h"
+#include "ResolverCache.h"
+#include "pplpp.h"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+using namespace InetSpeedUWP;
+using namespace Concurrency;
+using namespace Platform;
+using namespace Windows::Networking;
+using namespace Windows::Networking::Sockets;
+using namespace pplpp;
+
+namespace
+{
+	// Shared state of one Connect() call; every attempt and stagger timer holds a reference to it.
+	struct ConnectRace
+	{
+		std::vector<HostName^> addresses;
+		double dnsLatency;
+		String^ serviceName;
+		std::chrono::milliseconds attemptDelay;
+		//one per address: set to true when that attempt's turn comes, to false once the race is over without it...
+		std::vector<task_completion_event<bool>> starts;
+		cancellation_token_source losers;
+		cancellation_token token;
+	};
+
+	//Only the first call for an attempt counts, so the stagger timer and a failed predecessor can both try...
+	void StartAttempt(const std::shared_ptr<ConnectRace>& race, size_t attempt)
+	{
+		if (attempt < race->starts.size())
+		{
+			race->starts[attempt].set(true);
+		}
+	}
+
+	void AbandonAttempts(const std::shared_ptr<ConnectRace>& race)
+	{
+		for (auto& start : race->starts)
+		{
+			start.set(false);
+		}
+	}
+
+	void OnAttemptFailed(const std::shared_ptr<ConnectRace>& race, size_t attempt, StreamSocket^ clientSocket)
+	{
+		delete clientSocket;
+		//a failed attempt does not wait out its head start, the next address goes right away...
+		StartAttempt(race, attempt + 1);
+	}
+
+	task<DualStackConnection> RunAttempt(std::shared_ptr<ConnectRace> race, size_t attempt)
+	{
+		return create_task(race->starts[attempt]).then([race, attempt](bool start)
+		{
+			if (!start)
+			{
+				cancel_current_task();
+			}
+
+			auto address = race->addresses[attempt];
+			StreamSocket^ clientSocket = nullptr;
+			task<void> connect;
+			auto started = std::chrono::steady_clock::now();
+			try
+			{
+				clientSocket = ref new StreamSocket();
+				clientSocket->Control->NoDelay = true;
+				clientSocket->Control->QualityOfService = SocketQualityOfService::LowLatency;
+				clientSocket->Control->KeepAlive = false;
+				connect = create_task(clientSocket->ConnectAsync(address, race->serviceName, SocketProtectionLevel::PlainSocket), race->token);
+			}
+			catch (Platform::COMException^) //refused before it started (invalid address, access denied), counts as a failed attempt...
+			{
+				OnAttemptFailed(race, attempt, clientSocket);
+				throw;
+			}
+
+			//give this attempt a head start, then race the next address...
+			create_timer_task(race->attemptDelay, race->token).then([race, attempt](task<void> delay)
+			{
+				try
+				{
+					delay.get();
+				}
+				catch (task_canceled&)
+				{
+					return;
+				}
+				StartAttempt(race, attempt + 1);
+			}, task_continuation_context::use_arbitrary());
+
+			return connect.then([race, attempt, clientSocket, address, started](task<void> connected)
+			{
+				//what a user-space timer around ConnectAsync would report, scheduling and completion delivery included...
+				auto connectTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+				try
+				{
+					connected.get();
+				}
+				catch (Platform::COMException^)
+				{
+					OnAttemptFailed(race, attempt, clientSocket);
+					throw;
+				}
+				catch (task_canceled&)
+				{
+					OnAttemptFailed(race, attempt, clientSocket);
+					throw;
+				}
+
+				//a connect that loses by a hair is dropped by when_first_success, and its socket closes with it...
+				DualStackConnection connection = { clientSocket, address->Type, race->dnsLatency, connectTime };
+				return connection;
+			}, task_continuation_context::use_arbitrary());
+		}, task_continuation_context::use_arbitrary());
+	}
+}
+
+DualStackConnector::DualStackConnector(std::chrono::milliseconds attemptDelay) :
+	_attemptDelay(attemptDelay)
+{
+}
+
+task<DualStackConnection> DualStackConnector::Connect(HostName^ hostName, String^ serviceName, cancellation_token token, std::chrono::milliseconds timeout) const
+{
+	auto race = std::make_shared<ConnectRace>();
+	race->serviceName = serviceName;
+	race->attemptDelay = _attemptDelay;
+	race->dnsLatency = 0.0;
+	race->token = token;
+
+	return ResolverCache::Instance().Resolve(hostName, serviceName).then([race, hostName, token, timeout](task<Resolution> resolve)
+	{
+		try
+		{
+			auto resolution = resolve.get();
+			race->addresses = resolution.Addresses;
+			race->dnsLatency = resolution.Latency;
+		}
+		catch (Platform::COMException^) //resolution failed, let the stack resolve the name itself...
+		{
+		}
+
+		if (race->addresses.empty())
+		{
+			race->addresses.push_back(hostName);
+		}
+
+		//the timeout covers the connects only, name resolution is not part of the round trip...
+		timed_cancellation_token_source tcs;
+		auto connectTimeout = tcs.cancel(timeout);
+		std::vector<cancellation_token> tokens = { tcs.get_token(), token, race->losers.get_token() };
+		race->token = cancellation_token_source::create_linked_source(tokens.begin(), tokens.end()).get_token();
+
+		//once there is a winner, a timeout or a cancelled caller, attempts still waiting for their turn give up...
+		race->starts.resize(race->addresses.size());
+		auto over = race->token.register_callback([race]
+		{
+			AbandonAttempts(race);
+		});
+
+		std::vector<task<DualStackConnection>> attempts;
+		for (size_t i = 0; i < race->addresses.size(); ++i)
+		{
+			attempts.push_back(RunAttempt(race, i));
+		}
+		StartAttempt(race, 0);
+
+		return when_first_success(attempts, race->losers).then([race, connectTimeout, over](task<DualStackConnection> connect)
+		{
+			connectTimeout.disarm();
+			race->token.deregister_callback(over);
+			return connect.get();
+		}, task_continuation_context::use_arbitrary());
+	}, token, task_continuation_context::use_arbitrary());
+}
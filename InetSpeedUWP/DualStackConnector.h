@@ -0,0 +1,35 @@
+#pragma once
+#include "pch.h"
+
+#include <chrono>
+
+namespace InetSpeedUWP
+{
+	// Winning connection of a dual-stack race; Family is HostNameType::Ipv4 or HostNameType::Ipv6.
+	// DnsLatency is the time spent resolving the host in seconds, 0 if it came from the ResolverCache, and
+	// ConnectTime the wall-clock time from starting the winning ConnectAsync to seeing it complete.
+	struct DualStackConnection
+	{
+		Windows::Networking::Sockets::StreamSocket^ Socket;
+		Windows::Networking::HostNameType Family;
+		double DnsLatency;
+		double ConnectTime;
+	};
+
+	// Happy Eyeballs (RFC 8305) connector. Resolves a host name to all of its addresses through the ResolverCache
+	// (families interleaved, IPv6 first) and starts one connect every attemptDelay until one of them succeeds;
+	// a failed attempt starts the next one right away. The attempts race through pplpp::when_first_success: the
+	// first connect to complete wins and every other attempt is cancelled. The task fails with the last attempt's
+	// error if none succeeds, or with task_canceled if the token is cancelled or the timeout, which starts once
+	// the name is resolved, expires first. The caller owns the returned socket.
+	class DualStackConnector
+	{
+	public:
+		DualStackConnector(std::chrono::milliseconds attemptDelay);
+
+		concurrency::task<DualStackConnection> Connect(Windows::Networking::HostName^ hostName, Platform::String^ serviceName, concurrency::cancellation_token token, std::chrono::milliseconds timeout) const;
+
+	private:
+		std::chrono::milliseconds _attemptDelay;
+	};
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "pch.h"
+#include "EchoPool.h"
+
+namespace InetSpeedUWP
+{
+	// Result of InternetConnectionState::GetEchoLatencyAsync. Latencies are echo round-trip times in seconds over
+	// persistent connections (0 if no echo came back); percentiles cover every sample.
+	public ref class EchoLatencyResult sealed
+	{
+	public:
+		property double Median { double get() { return _samples.Rtt.Median(); } }
+		property double P90 { double get() { return _samples.Rtt.P90(); } }
+		property double P99 { double get() { return _samples.Rtt.P99(); } }
+		property double Jitter { double get() { return _samples.Rtt.Jitter(); } }
+		property int SampleCount { int get() { return static_cast<int>(_samples.Rtt.Count()); } }
+		property int FailedCount { int get() { return static_cast<int>(_samples.Failed); } }
+
+	internal:
+		EchoLatencyResult(const EchoSamples& samples) : _samples(samples) {}
+
+	private:
+		EchoSamples _samples;
+	};
+}
@@ -0,0 +1,479 @@
+#include "pch.h"
+#include "EchoPool.h"
+#include "ReflectorProtocol.h"
+#include "pplpp.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace InetSpeedUWP;
+using namespace Concurrency;
+using namespace Platform;
+using namespace Windows::Networking;
+using namespace Windows::Networking::Sockets;
+using namespace Windows::Storage::Streams;
+using namespace pplpp;
+
+const size_t default_echo_connections = 4;
+const long long default_echo_idle_ms = 30000;
+const long long default_echo_timeout_ms = 1000;
+
+namespace
+{
+	using ReflectorProtocol::clock_type;
+	using ReflectorProtocol::Timestamp;
+
+	// One open echo connection; the reader and writer stay attached for its whole life.
+	struct EchoConnection
+	{
+		StreamSocket^ Socket;
+		DataReader^ Reader;
+		DataWriter^ Writer;
+		unsigned long long NextSequence;
+		clock_type::time_point LastUsed;
+	};
+
+	typedef std::shared_ptr<EchoConnection> EchoConnectionPtr;
+}
+
+namespace InetSpeedUWP
+{
+	struct EchoPoolState
+	{
+		std::mutex Lock;
+		HostName^ Host;
+		String^ Service;
+		size_t MaxConnections;
+		std::chrono::milliseconds IdleTimeout;
+		std::chrono::milliseconds EchoTimeout;
+		size_t Open;
+		std::vector<EchoConnectionPtr> Idle;
+		std::deque<task_completion_event<EchoConnectionPtr>> Waiters;
+		bool SweepArmed;
+		bool Closed;
+	};
+}
+
+namespace
+{
+	void CloseConnection(const EchoConnectionPtr& connection)
+	{
+		delete connection->Socket;
+	}
+
+	//Caller must hold state.Lock; returns the connections to close once the lock is released...
+	std::vector<EchoConnectionPtr> TakeExpired(EchoPoolState& state)
+	{
+		auto now = clock_type::now();
+		std::vector<EchoConnectionPtr> expired;
+		auto idleTimeout = state.IdleTimeout;
+		auto firstKept = std::stable_partition(state.Idle.begin(), state.Idle.end(), [now, idleTimeout](const EchoConnectionPtr& connection)
+		{
+			return now - connection->LastUsed >= idleTimeout;
+		});
+		expired.assign(state.Idle.begin(), firstKept);
+		state.Idle.erase(state.Idle.begin(), firstKept);
+		state.Open -= expired.size();
+		return expired;
+	}
+
+	void ArmSweep(std::shared_ptr<EchoPoolState> state);
+
+	void Sweep(std::weak_ptr<EchoPoolState> weakState)
+	{
+		auto state = weakState.lock();
+		if (state == nullptr)
+		{
+			return;
+		}
+
+		std::vector<EchoConnectionPtr> expired;
+		bool rearm = false;
+		{
+			std::lock_guard<std::mutex> scopedLock(state->Lock);
+			state->SweepArmed = false;
+			expired = TakeExpired(*state);
+			rearm = !state->Idle.empty() && !state->Closed;
+		}
+
+		for (auto& connection : expired)
+		{
+			CloseConnection(connection);
+		}
+		if (rearm)
+		{
+			ArmSweep(state);
+		}
+	}
+
+	void ArmSweep(std::shared_ptr<EchoPoolState> state)
+	{
+		{
+			std::lock_guard<std::mutex> scopedLock(state->Lock);
+			if (state->SweepArmed)
+			{
+				return;
+			}
+			state->SweepArmed = true;
+		}
+
+		//the timer holds no reference, a pool nobody uses any more just goes away...
+		std::weak_ptr<EchoPoolState> weakState = state;
+		create_timer_task(state->IdleTimeout).then([weakState]
+		{
+			Sweep(weakState);
+		});
+	}
+
+	task<EchoConnectionPtr> OpenConnection(std::shared_ptr<EchoPoolState> state)
+	{
+		StreamSocket^ clientSocket = nullptr;
+		task<void> connect;
+		try
+		{
+			clientSocket = ref new StreamSocket();
+			clientSocket->Control->NoDelay = true;
+			clientSocket->Control->QualityOfService = SocketQualityOfService::LowLatency;
+			connect = create_task(clientSocket->ConnectAsync(state->Host, state->Service, SocketProtectionLevel::PlainSocket));
+		}
+		catch (Platform::COMException^ e) //fail the task, so the caller's Open count and waiter are settled as for any failed connect...
+		{
+			delete clientSocket;
+			return task_from_exception<EchoConnectionPtr>(e);
+		}
+
+		return connect.then([clientSocket]
+		{
+			auto connection = std::make_shared<EchoConnection>();
+			connection->Socket = clientSocket;
+			connection->Reader = ref new DataReader(clientSocket->InputStream);
+			connection->Writer = ref new DataWriter(clientSocket->OutputStream);
+			connection->NextSequence = 0;
+			connection->Writer->WriteByte(ReflectorProtocol::EchoCommand);
+			return create_task(connection->Writer->StoreAsync()).then([connection](unsigned int)
+			{
+				return connection;
+			});
+		}).then([clientSocket](task<EchoConnectionPtr> opened)
+		{
+			try
+			{
+				return opened.get();
+			}
+			catch (...)
+			{
+				delete clientSocket;
+				throw;
+			}
+		});
+	}
+
+	//Opens a connection on behalf of a caller that was promised one, passing failure on to it...
+	void OpenFor(std::shared_ptr<EchoPoolState> state, task_completion_event<EchoConnectionPtr> waiter)
+	{
+		OpenConnection(state).then([state, waiter](task<EchoConnectionPtr> opened)
+		{
+			try
+			{
+				waiter.set(opened.get());
+			}
+			catch (...)
+			{
+				{
+					std::lock_guard<std::mutex> scopedLock(state->Lock);
+					state->Open--;
+				}
+				waiter.set_exception(std::current_exception());
+			}
+		});
+	}
+
+	task<EchoConnectionPtr> Acquire(std::shared_ptr<EchoPoolState> state)
+	{
+		std::vector<EchoConnectionPtr> expired;
+		task_completion_event<EchoConnectionPtr> waiter;
+		bool open = false;
+		EchoConnectionPtr reused;
+		{
+			std::lock_guard<std::mutex> scopedLock(state->Lock);
+			if (state->Closed)
+			{
+				return task_from_exception<EchoConnectionPtr>(task_canceled());
+			}
+
+			expired = TakeExpired(*state);
+			if (!state->Idle.empty())
+			{
+				//most recently used first, the others may age out...
+				reused = state->Idle.back();
+				state->Idle.pop_back();
+			}
+			else if (state->Open < state->MaxConnections)
+			{
+				state->Open++;
+				open = true;
+			}
+			else
+			{
+				state->Waiters.push_back(waiter);
+			}
+		}
+
+		for (auto& connection : expired)
+		{
+			CloseConnection(connection);
+		}
+
+		if (reused != nullptr)
+		{
+			return task_from_result(reused);
+		}
+		if (open)
+		{
+			OpenFor(state, waiter);
+		}
+		return create_task(waiter);
+	}
+
+	void Release(std::shared_ptr<EchoPoolState> state, EchoConnectionPtr connection, bool healthy)
+	{
+		task_completion_event<EchoConnectionPtr> waiter;
+		bool handOff = false;
+		bool replace = false;
+		bool keep = false;
+		{
+			std::lock_guard<std::mutex> scopedLock(state->Lock);
+			keep = healthy && !state->Closed;
+			if (keep)
+			{
+				if (!state->Waiters.empty())
+				{
+					waiter = state->Waiters.front();
+					state->Waiters.pop_front();
+					handOff = true;
+				}
+				else
+				{
+					connection->LastUsed = clock_type::now();
+					state->Idle.push_back(connection);
+				}
+			}
+			else
+			{
+				//a broken connection makes room for a fresh one if someone is waiting...
+				if (!state->Waiters.empty() && !state->Closed)
+				{
+					waiter = state->Waiters.front();
+					state->Waiters.pop_front();
+					replace = true;
+				}
+				else
+				{
+					state->Open--;
+				}
+			}
+		}
+
+		if (handOff)
+		{
+			waiter.set(connection);
+			return;
+		}
+		if (!keep)
+		{
+			CloseConnection(connection);
+			if (replace)
+			{
+				OpenFor(state, waiter);
+			}
+			return;
+		}
+		ArmSweep(state);
+	}
+
+	//Echo RTT in seconds, negative if the frame came back wrong (the connection is out of sync)...
+	task<double> Echo(EchoConnectionPtr connection, std::chrono::milliseconds timeout)
+	{
+		auto sequence = connection->NextSequence++;
+		connection->Writer->WriteUInt64(sequence);
+		connection->Writer->WriteUInt64(Timestamp());
+
+		timed_cancellation_token_source tcs;
+		auto pending = tcs.cancel(timeout);
+		auto token = tcs.get_token();
+
+		//the read is where a silent reflector leaves us waiting, cancelling it is what makes the timeout work...
+		return create_task(connection->Writer->StoreAsync(), token).then([connection, token]
+		{
+			return create_task(connection->Reader->LoadAsync(ReflectorProtocol::EchoFrameSize), token);
+		}, token, task_continuation_context::use_arbitrary()).then([connection, sequence, pending](task<unsigned int> loaded)
+		{
+			pending.disarm();
+			if (loaded.get() != ReflectorProtocol::EchoFrameSize)
+			{
+				return -1.0;
+			}
+
+			auto echoedSequence = connection->Reader->ReadUInt64();
+			auto sent = connection->Reader->ReadUInt64();
+			auto now = Timestamp();
+			if (echoedSequence != sequence || sent > now)
+			{
+				return -1.0;
+			}
+			return (now - sent) / 1000000000.0;
+		}, task_continuation_context::use_arbitrary());
+	}
+
+	task<double> Ping(std::shared_ptr<EchoPoolState> state)
+	{
+		return Acquire(state).then([state](EchoConnectionPtr connection)
+		{
+			return Echo(connection, state->EchoTimeout).then([state, connection](task<double> echoed)
+			{
+				double rtt = -1.0;
+				try
+				{
+					rtt = echoed.get();
+				}
+				catch (Platform::COMException^) //the reflector went away, this connection is done...
+				{
+				}
+				catch (task_canceled&) //echo timeout exceeded, the reply may still arrive and desync the stream...
+				{
+				}
+
+				Release(state, connection, rtt >= 0.0);
+				return rtt;
+			});
+		});
+	}
+}
+
+EchoPool::EchoPool(HostName^ hostName, String^ serviceName, size_t maxConnections, std::chrono::milliseconds idleTimeout, std::chrono::milliseconds echoTimeout) :
+	_state(std::make_shared<EchoPoolState>())
+{
+	_state->Host = hostName;
+	_state->Service = serviceName;
+	_state->MaxConnections = std::max<size_t>(maxConnections, 1);
+	_state->IdleTimeout = idleTimeout;
+	_state->EchoTimeout = echoTimeout;
+	_state->Open = 0;
+	_state->SweepArmed = false;
+	_state->Closed = false;
+}
+
+std::shared_ptr<EchoPool> EchoPool::For(HostName^ hostName, String^ serviceName)
+{
+	// Never destroyed, like the other process-wide caches; idle pools hold no sockets once they are swept.
+	static std::mutex* lock = new std::mutex();
+	static std::map<std::wstring, std::shared_ptr<EchoPool>>* pools = new std::map<std::wstring, std::shared_ptr<EchoPool>>();
+
+	std::wstring key(hostName->CanonicalName->Data());
+	key += L"|";
+	key += serviceName == nullptr ? L"" : serviceName->Data();
+
+	std::lock_guard<std::mutex> scopedLock(*lock);
+	auto& pool = (*pools)[key];
+	if (pool == nullptr)
+	{
+		pool = std::make_shared<EchoPool>(hostName, serviceName, default_echo_connections, std::chrono::milliseconds(default_echo_idle_ms), std::chrono::milliseconds(default_echo_timeout_ms));
+	}
+	return pool;
+}
+
+task<EchoSamples> EchoPool::Sample(size_t count) const
+{
+	auto samples = std::make_shared<EchoSamples>();
+	samples->Failed = 0;
+	if (count == 0)
+	{
+		return task_from_result(*samples);
+	}
+
+	auto state = _state;
+	auto samplesLock = std::make_shared<std::mutex>();
+	auto remaining = std::make_shared<std::atomic<size_t>>(count);
+
+	//one sampling loop per connection, each taking the next sample until none are left...
+	std::vector<task<void>> workers;
+	auto workerCount = std::min(count, state->MaxConnections);
+	for (size_t i = 0; i < workerCount; ++i)
+	{
+		workers.push_back(create_iterative_task([state, samples, samplesLock, remaining]
+		{
+			size_t left = remaining->load();
+			do
+			{
+				if (left == 0)
+				{
+					return task_from_result(false);
+				}
+			} while (!remaining->compare_exchange_weak(left, left - 1));
+
+			return Ping(state).then([samples, samplesLock](task<double> ping)
+			{
+				double rtt = -1.0;
+				try
+				{
+					rtt = ping.get();
+				}
+				catch (Platform::COMException^) //could not connect...
+				{
+				}
+				catch (task_canceled&) //pool closed...
+				{
+				}
+
+				std::lock_guard<std::mutex> scopedLock(*samplesLock);
+				if (rtt >= 0.0)
+				{
+					samples->Rtt.Add(rtt);
+				}
+				else
+				{
+					samples->Failed++;
+				}
+				return true;
+			});
+		}));
+	}
+
+	return concurrency::when_all(workers.begin(), workers.end()).then([samples]
+	{
+		return *samples;
+	});
+}
+
+size_t EchoPool::OpenConnections() const
+{
+	std::lock_guard<std::mutex> scopedLock(_state->Lock);
+	return _state->Open;
+}
+
+void EchoPool::Close()
+{
+	std::vector<EchoConnectionPtr> idle;
+	std::deque<task_completion_event<EchoConnectionPtr>> waiters;
+	{
+		std::lock_guard<std::mutex> scopedLock(_state->Lock);
+		_state->Closed = true;
+		idle.swap(_state->Idle);
+		waiters.swap(_state->Waiters);
+		_state->Open -= idle.size();
+	}
+
+	for (auto& connection : idle)
+	{
+		CloseConnection(connection);
+	}
+	for (auto& waiter : waiters)
+	{
+		waiter.set_exception(std::make_exception_ptr(task_canceled()));
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "pch.h"
+#include "RttEstimator.h"
+
+#include <chrono>
+#include <memory>
+
+namespace InetSpeedUWP
+{
+	struct EchoPoolState;
+
+	// Outcome of EchoPool::Sample: RTTs of the echoes that came back, and how many did not.
+	struct EchoSamples
+	{
+		RttEstimator Rtt;
+		size_t Failed;
+	};
+
+	// Persistent echo connections to a ReflectorServer ('E' mode), so RTT samples cost no handshakes.
+	// Each sample writes a timestamped, sequence-numbered frame on an open connection and times the echo.
+	// Up to maxConnections connections are opened on demand and reused; callers beyond that wait for one to
+	// come free. A connection whose echo fails, times out or comes back with the wrong sequence number is
+	// closed instead of being reused, and connections left idle for idleTimeout are closed as well.
+	class EchoPool
+	{
+	public:
+		EchoPool(Windows::Networking::HostName^ hostName, Platform::String^ serviceName, size_t maxConnections, std::chrono::milliseconds idleTimeout, std::chrono::milliseconds echoTimeout);
+
+		// Pool shared by every caller measuring hostName:serviceName, with default settings.
+		static std::shared_ptr<EchoPool> For(Windows::Networking::HostName^ hostName, Platform::String^ serviceName);
+
+		// Takes count samples, running one per connection at a time.
+		concurrency::task<EchoSamples> Sample(size_t count) const;
+
+		size_t OpenConnections() const;
+		void Close();
+
+	private:
+		std::shared_ptr<EchoPoolState> _state;
+	};
+}
@@ -16,5 +16,11 @@ namespace InetSpeedUWP
 		LAN,
 		None
 	};
+
+	private enum class TransferDirection
+	{
+		Download,
+		Upload
+	};
 }
 
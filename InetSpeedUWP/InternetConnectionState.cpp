@@ -1,6 +1,13 @@
 #include "pch.h"
 #include "InternetConnectionState.h"
+#include "EchoPool.h"
 #include "Enums.h"
+#include "LatencyUnderLoad.h"
+#include "MeasurementSession.h"
+#include "ResolverCache.h"
+#include "TimeoutPolicy.h"
+#include "ThroughputMeter.h"
+#include "UdpProber.h"
 #include "pplpp.h"
 
 using namespace InetSpeedUWP;
@@ -9,7 +16,14 @@ using namespace Windows::Networking::Connectivity;
 using namespace Windows::Networking::Sockets;
 using namespace pplpp;
 
-Array<String^>^ _socketTcpWellKnownHostNames = ref new Array <String^>(4) { "google.com", "bing.com", "facebook.com", "yahoo.com" };
+const unsigned int throughput_streams = 4;
+const long long throughput_duration_ms = 5000;
+const long long throughput_warmup_ms = 1000;
+const long long loaded_duration_ms = 8000;
+const long long loaded_sample_interval_ms = 100;
+const long long loaded_probe_timeout_ms = 2000;
+const long long udp_probe_interval_ms = 20;
+const long long udp_probe_linger_ms = 1000;
 
 //Care of http://stackoverflow.com/a/16533789
 ConnectionType InternetConnectionState::GetConnectionType()
@@ -59,77 +73,20 @@ ConnectionSpeed InternetConnectionState::GetConnectionSpeed(double roundtriptime
 	return ConnectionSpeed::Low;
 }
 
-ConnectionSpeed InternetConnectionState::InternetConnectSocketAsync()
+task<ConnectionSpeed> InternetConnectionState::GetCachedConnectionSpeed(HostName^ hostName)
 {
-	bool _canceled = false;
-	int retries = 4;
-	long long task_timeout_ms = 1000;
-	auto connectionType = InternetConnectionState::GetConnectionType();
-
-	if (connectionType == ConnectionType::LAN)
+	return SpeedCache::Instance().Get(hostName == nullptr ? nullptr : hostName->CanonicalName, [hostName]
 	{
-		task_timeout_ms = 1000;
-	}
-
-	if (connectionType == ConnectionType::Cellular || connectionType == ConnectionType::WiFi)
-	{
-		retries = 2;
-	}
-
-	double currentSpeed = 0.0;
-
-	for (int i = 0; i < retries; ++i)
+		auto session = hostName == nullptr ? ref new MeasurementSession() : ref new MeasurementSession(hostName);
+		return session->MeasureAsync();
+	}).then([](SpeedMeasurement measurement)
 	{
-		if (_serverHost == nullptr || !_custom)
-		{
-			_serverHost = ref new HostName(_socketTcpWellKnownHostNames[i]);
-		}
-
-		StreamSocket^ _clientSocket = ref new StreamSocket();
-		_clientSocket->Control->NoDelay = true;
-		_clientSocket->Control->QualityOfService = SocketQualityOfService::LowLatency;
-		_clientSocket->Control->KeepAlive = false;
-
-		//tasks must complete in a fixed amount of time, cancel otherwise..
-		timed_cancellation_token_source tcs;
-		std::chrono::milliseconds timeout(task_timeout_ms);
-
-		try
-		{
-			create_task([&]
-			{
-				tcs.cancel(timeout);
-				return _clientSocket->ConnectAsync(_serverHost, "80", SocketProtectionLevel::PlainSocket);
-			}, tcs.get_token()).then([&]
-			{
-				currentSpeed += _clientSocket->Information->RoundTripTimeStatistics.Min / 1000000.0;
-			}).get();
-		}
-		catch (Platform::COMException^ e) //naughty, but sometimes this happens and should not crash this component...
-		{
-			currentSpeed = 0.0;
-			retries--;
-		}
-		catch (task_canceled&) //task timeout exceeded, for example...
+		if (measurement.Speed != ConnectionSpeed::Unknown)
 		{
-			currentSpeed = 0.0;
-			retries--;
+			RawSpeed = measurement.RawSpeed;
 		}
-
-		delete _clientSocket;
-	}
-
-	//Compute speed...
-	if (currentSpeed == 0.0)
-	{
-		return ConnectionSpeed::Unknown;
-	}
-	else
-	{
-		double rawSpeed = currentSpeed / retries;
-		RawSpeed = rawSpeed;
-		return GetConnectionSpeed(rawSpeed);
-	}
+		return measurement.Speed;
+	});
 }
 
 IAsyncOperation<ConnectionSpeed>^ InternetConnectionState::GetInternetConnectionSpeed()
@@ -142,12 +99,9 @@ IAsyncOperation<ConnectionSpeed>^ InternetConnectionState::GetInternetConnection
 		});
 	}
 
-	InternetConnectionState::_serverHost = nullptr;
-	InternetConnectionState::_custom = false;
-
-	return create_async([&]() -> ConnectionSpeed
+	return create_async([]() -> task<ConnectionSpeed>
 	{
-		return InternetConnectionState::InternetConnectSocketAsync();
+		return InternetConnectionState::GetCachedConnectionSpeed(nullptr);
 	});
 }
 
@@ -161,18 +115,111 @@ IAsyncOperation<ConnectionSpeed>^ InternetConnectionState::GetInternetConnection
 		});
 	}
 
-	if (hostName != nullptr)
+	return create_async([hostName]() -> task<ConnectionSpeed>
 	{
-		InternetConnectionState::_serverHost = hostName;
-		InternetConnectionState::_custom = true;
-	}
+		return InternetConnectionState::GetCachedConnectionSpeed(hostName);
+	});
+}
+
+IAsyncOperation<ThroughputResult^>^ InternetConnectionState::GetInternetThroughputAsync(HostName^ hostName, String^ serviceName)
+{
+	return create_async([hostName, serviceName]() -> task<ThroughputResult^>
+	{
+		ThroughputMeter meter(throughput_streams, std::chrono::milliseconds(throughput_duration_ms), std::chrono::milliseconds(throughput_warmup_ms));
+
+		//One direction at a time, so upload and download do not compete for the same link...
+		return meter.Measure(hostName, serviceName, TransferDirection::Download).then([meter, hostName, serviceName](double download)
+		{
+			return meter.Measure(hostName, serviceName, TransferDirection::Upload).then([download](double upload)
+			{
+				return ref new ThroughputResult(download, upload);
+			});
+		});
+	});
+}
+
+IAsyncOperation<LatencyUnderLoadResult^>^ InternetConnectionState::GetLatencyUnderLoadAsync(HostName^ hostName, String^ serviceName)
+{
+	return create_async([hostName, serviceName]() -> task<LatencyUnderLoadResult^>
+	{
+		ThroughputMeter load(throughput_streams, std::chrono::milliseconds(loaded_duration_ms), std::chrono::milliseconds(throughput_warmup_ms));
+		LatencyUnderLoadMeter meter(load, std::chrono::milliseconds(throughput_warmup_ms), std::chrono::milliseconds(loaded_sample_interval_ms), std::chrono::milliseconds(loaded_probe_timeout_ms));
+
+		return meter.Measure(hostName, serviceName).then([](LoadedLatency latency)
+		{
+			return ref new LatencyUnderLoadResult(latency);
+		});
+	});
+}
+
+IAsyncOperation<EchoLatencyResult^>^ InternetConnectionState::GetEchoLatencyAsync(HostName^ hostName, String^ serviceName, int samples)
+{
+	return create_async([hostName, serviceName, samples]() -> task<EchoLatencyResult^>
+	{
+		//the pool outlives this call, so repeated measurements reuse its open connections...
+		auto pool = EchoPool::For(hostName, serviceName);
+		return pool->Sample(samples > 0 ? static_cast<size_t>(samples) : 0).then([](EchoSamples echoed)
+		{
+			return ref new EchoLatencyResult(echoed);
+		});
+	});
+}
 
-	return create_async([&]() -> ConnectionSpeed
+IAsyncOperation<UdpProbeResult^>^ InternetConnectionState::GetUdpProbeAsync(HostName^ hostName, String^ serviceName, int packets)
+{
+	return create_async([hostName, serviceName, packets]() -> task<UdpProbeResult^>
 	{
-		return InternetConnectionState::InternetConnectSocketAsync();
+		UdpProber prober(packets > 0 ? static_cast<size_t>(packets) : 0, std::chrono::milliseconds(udp_probe_interval_ms), std::chrono::milliseconds(udp_probe_linger_ms));
+		return prober.Run(hostName, serviceName).then([](UdpProbeStats stats)
+		{
+			return ref new UdpProbeResult(stats);
+		});
 	});
 }
 
+TimeSpan InternetConnectionState::ResultCacheTimeToLive::get()
+{
+	TimeSpan timeToLive;
+	timeToLive.Duration = SpeedCache::Instance().TimeToLive().count() * 10000;
+	return timeToLive;
+}
+
+void InternetConnectionState::ResultCacheTimeToLive::set(TimeSpan value)
+{
+	SpeedCache::Instance().SetTimeToLive(std::chrono::milliseconds(value.Duration / 10000));
+}
+
+TimeSpan InternetConnectionState::ResultCacheStaleWindow::get()
+{
+	TimeSpan staleWindow;
+	staleWindow.Duration = SpeedCache::Instance().StaleWindow().count() * 10000;
+	return staleWindow;
+}
+
+void InternetConnectionState::ResultCacheStaleWindow::set(TimeSpan value)
+{
+	SpeedCache::Instance().SetStaleWindow(std::chrono::milliseconds(value.Duration / 10000));
+}
+
+TimeSpan InternetConnectionState::ResolverCacheTimeToLive::get()
+{
+	TimeSpan timeToLive;
+	timeToLive.Duration = ResolverCache::Instance().TimeToLive().count() * 10000;
+	return timeToLive;
+}
+
+void InternetConnectionState::ResolverCacheTimeToLive::set(TimeSpan value)
+{
+	ResolverCache::Instance().SetTimeToLive(std::chrono::milliseconds(value.Duration / 10000));
+}
+
+void InternetConnectionState::InvalidateResultCache()
+{
+	SpeedCache::Instance().Invalidate();
+	ResolverCache::Instance().Invalidate();
+	TimeoutPolicy::Instance().Invalidate();
+}
+
 bool InternetConnectionState::Connected::get()
 {
 	auto internetConnectionProfile = Windows::Networking::Connectivity::NetworkInformation::GetInternetConnectionProfile();
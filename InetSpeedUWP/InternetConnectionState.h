@@ -1,6 +1,11 @@
 #pragma once
 #include "pch.h"
+#include "EchoLatencyResult.h"
 #include "Enums.h"
+#include "LatencyUnderLoadResult.h"
+#include "SpeedCache.h"
+#include "ThroughputResult.h"
+#include "UdpProbeResult.h"
 
 using namespace Platform;
 using namespace Platform::Collections;
@@ -15,18 +20,26 @@ namespace InetSpeedUWP
 {
 	public ref class InternetConnectionState sealed
 	{
-		static ConnectionType InternetConnectionState::GetConnectionType();
-		static property bool _custom;
-		static ConnectionSpeed InternetConnectionState::InternetConnectSocketAsync();
+		static task<ConnectionSpeed> InternetConnectionState::GetCachedConnectionSpeed(HostName^ hostName);
 		static property bool _connected;
-		static property HostName^ _serverHost;
+
+	internal:
+		static ConnectionType InternetConnectionState::GetConnectionType();
 		static ConnectionSpeed InternetConnectionState::GetConnectionSpeed(double roundtriptime);
 
 	public:
 		static IAsyncOperation<ConnectionSpeed>^ InternetConnectionState::GetInternetConnectionSpeed();
 		static IAsyncOperation<ConnectionSpeed>^ InternetConnectionState::GetInternetConnectionSpeedWithHostName(HostName^ hostName);
+		static IAsyncOperation<ThroughputResult^>^ InternetConnectionState::GetInternetThroughputAsync(HostName^ hostName, String^ serviceName);
+		static IAsyncOperation<LatencyUnderLoadResult^>^ InternetConnectionState::GetLatencyUnderLoadAsync(HostName^ hostName, String^ serviceName);
+		static IAsyncOperation<EchoLatencyResult^>^ InternetConnectionState::GetEchoLatencyAsync(HostName^ hostName, String^ serviceName, int samples);
+		static IAsyncOperation<UdpProbeResult^>^ InternetConnectionState::GetUdpProbeAsync(HostName^ hostName, String^ serviceName, int packets);
 		static property bool InternetConnectionState::Connected { bool get(); }
 		static property double InternetConnectionState::RawSpeed;
+		static property TimeSpan InternetConnectionState::ResultCacheTimeToLive { TimeSpan get(); void set(TimeSpan value); }
+		static property TimeSpan InternetConnectionState::ResultCacheStaleWindow { TimeSpan get(); void set(TimeSpan value); }
+		static property TimeSpan InternetConnectionState::ResolverCacheTimeToLive { TimeSpan get(); void set(TimeSpan value); }
+		static void InternetConnectionState::InvalidateResultCache();
 	};
 }
 
@@ -0,0 +1,85 @@
+#include "pch.h"
+#include "LatencyUnderLoad.h"
+#include "ProbeEngine.h"
+#include "pplpp.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+using namespace InetSpeedUWP;
+using namespace Concurrency;
+using namespace Platform;
+using namespace Windows::Networking;
+using namespace pplpp;
+
+const size_t idle_probes = 5;
+
+LatencyUnderLoadMeter::LatencyUnderLoadMeter(ThroughputMeter load, std::chrono::milliseconds warmup, std::chrono::milliseconds sampleInterval, std::chrono::milliseconds probeTimeout) :
+	_load(load),
+	_warmup(warmup),
+	_sampleInterval(sampleInterval),
+	_probeTimeout(probeTimeout)
+{
+}
+
+task<LoadedLatency> LatencyUnderLoadMeter::Measure(HostName^ hostName, String^ serviceName) const
+{
+	auto result = std::make_shared<LoadedLatency>();
+	result->ThroughputBitsPerSecond = 0.0;
+
+	ProbeEngine engine(idle_probes, _probeTimeout);
+	std::vector<HostName^> idleTargets(idle_probes, hostName);
+	auto load = _load;
+	auto warmup = _warmup;
+	auto sampleInterval = _sampleInterval;
+
+	return engine.Run(idleTargets, serviceName, idle_probes).then([=](std::vector<ProbeResult> idle)
+	{
+		for (const auto& probe : idle)
+		{
+			if (probe.Succeeded)
+			{
+				result->Idle.Add(probe.Rtt);
+			}
+		}
+
+		//the sampler also stops on its own deadline, whatever state the download is in...
+		auto loadDone = std::make_shared<std::atomic<bool>>(false);
+		auto samplingDeadline = std::chrono::steady_clock::now() + warmup + load.Duration();
+		auto download = load.Measure(hostName, serviceName, TransferDirection::Download).then([result, loadDone](task<double> measured)
+		{
+			//stop the sampler however the download ends, then pass a failure on...
+			*loadDone = true;
+			result->ThroughputBitsPerSecond = measured.get();
+		});
+
+		//probe one connect at a time while the download keeps the link busy...
+		auto sampler = create_timer_task(warmup).then([=]
+		{
+			return create_iterative_task([=]
+			{
+				std::vector<HostName^> target(1, hostName);
+				return engine.Run(target, serviceName, 1).then([=](std::vector<ProbeResult> probe)
+				{
+					if (!probe.empty() && probe.front().Succeeded)
+					{
+						result->Loaded.Add(probe.front().Rtt);
+					}
+					return create_timer_task(sampleInterval);
+				}).then([loadDone, samplingDeadline]
+				{
+					return !loadDone->load() && std::chrono::steady_clock::now() < samplingDeadline;
+				});
+			});
+		});
+
+		std::vector<task<void>> phases;
+		phases.push_back(download);
+		phases.push_back(sampler);
+		return concurrency::when_all(phases.begin(), phases.end());
+	}).then([result]
+	{
+		return *result;
+	});
+}
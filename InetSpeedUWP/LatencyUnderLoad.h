@@ -0,0 +1,36 @@
+#pragma once
+#include "pch.h"
+#include "RttEstimator.h"
+#include "ThroughputMeter.h"
+
+#include <chrono>
+
+namespace InetSpeedUWP
+{
+	// Connect RTT measured on an idle link and while the link is saturated by a download.
+	struct LoadedLatency
+	{
+		RttEstimator Idle;
+		RttEstimator Loaded;
+		double ThroughputBitsPerSecond;
+	};
+
+	// Bufferbloat measurement against a ReflectorServer. Takes a handful of idle connect probes first, then
+	// starts a saturating multi-stream download and keeps probing at a fixed interval (after the load's warm-up)
+	// until the download ends, or the warm-up plus the load's duration has passed, whichever comes first.
+	// It needs a real bottleneck link to show anything: a ReflectorServer's BandwidthBitsPerSecond only paces
+	// the server's own reads and writes and builds no queue for a probe's handshake to wait in.
+	class LatencyUnderLoadMeter
+	{
+	public:
+		LatencyUnderLoadMeter(ThroughputMeter load, std::chrono::milliseconds warmup, std::chrono::milliseconds sampleInterval, std::chrono::milliseconds probeTimeout);
+
+		concurrency::task<LoadedLatency> Measure(Windows::Networking::HostName^ hostName, Platform::String^ serviceName) const;
+
+	private:
+		ThroughputMeter _load;
+		std::chrono::milliseconds _warmup;
+		std::chrono::milliseconds _sampleInterval;
+		std::chrono::milliseconds _probeTimeout;
+	};
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "pch.h"
+#include "LatencyUnderLoad.h"
+
+namespace InetSpeedUWP
+{
+	// Result of InternetConnectionState::GetLatencyUnderLoadAsync. Latencies are connect round-trip times in seconds,
+	// taken on the idle link and while a saturating download was running (percentiles cover every sample, however
+	// long the load ran); 0 means no sample was collected.
+	public ref class LatencyUnderLoadResult sealed
+	{
+	public:
+		property double IdleMedian { double get() { return _latency.Idle.Median(); } }
+		property double IdleP90 { double get() { return _latency.Idle.P90(); } }
+		property double IdleP99 { double get() { return _latency.Idle.P99(); } }
+		property double LoadedMedian { double get() { return _latency.Loaded.Median(); } }
+		property double LoadedP90 { double get() { return _latency.Loaded.P90(); } }
+		property double LoadedP99 { double get() { return _latency.Loaded.P99(); } }
+		property double LoadedThroughputBitsPerSecond { double get() { return _latency.ThroughputBitsPerSecond; } }
+
+		// Round trips per minute the link sustains under load (60 / LoadedMedian); higher is more responsive.
+		property double ResponsivenessRpm
+		{
+			double get()
+			{
+				auto loaded = _latency.Loaded.Median();
+				return loaded > 0.0 ? 60.0 / loaded : 0.0;
+			}
+		}
+
+	internal:
+		LatencyUnderLoadResult(const LoadedLatency& latency) : _latency(latency) {}
+
+	private:
+		LoadedLatency _latency;
+	};
+}
@@ -0,0 +1,218 @@
+#include "pch.h"
+#include "MeasurementSession.h"
+#include "InternetConnectionState.h"
+#include "ProbeEngine.h"
+#include "SpeedBucketStopRule.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace InetSpeedUWP;
+using namespace Concurrency;
+using namespace Platform;
+using namespace Platform::Collections;
+using namespace Windows::Foundation;
+using namespace Windows::Foundation::Collections;
+using namespace Windows::Networking;
+
+Array<String^>^ _socketTcpWellKnownHostNames = ref new Array <String^>(4) { "google.com", "bing.com", "facebook.com", "yahoo.com" };
+const size_t max_probes_in_flight = 8;
+const int max_adaptive_probes = 8;
+const size_t min_adaptive_samples = 2;
+const long long default_timeout_ms = 1000;
+const long long default_min_timeout_ms = 50;
+
+MeasurementSession::MeasurementSession() :
+	_targets(ref new Vector<HostName^>())
+{
+	SetDefaults();
+}
+
+MeasurementSession::MeasurementSession(HostName^ hostName) :
+	_targets(ref new Vector<HostName^>())
+{
+	SetDefaults();
+	if (hostName != nullptr)
+	{
+		_targets->Append(hostName);
+	}
+}
+
+void MeasurementSession::SetDefaults()
+{
+	_measurement.Speed = ConnectionSpeed::Unknown;
+	_measurement.RawSpeed = 0.0;
+	ServiceName = "80";
+	Probes = 0;
+	TimeSpan timeout;
+	timeout.Duration = default_timeout_ms * 10000;
+	Timeout = timeout;
+	TimeSpan minTimeout;
+	minTimeout.Duration = default_min_timeout_ms * 10000;
+	MinTimeout = minTimeout;
+}
+
+IVector<HostName^>^ MeasurementSession::Targets::get()
+{
+	return _targets;
+}
+
+task<SpeedMeasurement> MeasurementSession::MeasureAsync()
+{
+	//Snapshot the options so the measurement does not depend on anything shared...
+	IVector<HostName^>^ targetList = _targets;
+	std::vector<HostName^> hosts(begin(targetList), end(targetList));
+	String^ serviceName = ServiceName;
+	if (serviceName == nullptr || serviceName->IsEmpty())
+	{
+		serviceName = "80";
+	}
+	TimeoutBounds timeout;
+	timeout.Max = std::chrono::milliseconds(Timeout.Duration > 0 ? Timeout.Duration / 10000 : default_timeout_ms);
+	timeout.Min = std::min(std::chrono::milliseconds(MinTimeout.Duration > 0 ? MinTimeout.Duration / 10000 : 0), timeout.Max);
+	MeasurementSession^ self = this;
+
+	//A fixed probe count waits for half of the probes. Otherwise probe a few at a time (4 on LAN, 2 on WiFi or
+	//Cellular) and stop as soon as the samples pin down the speed bucket, up to max_adaptive_probes...
+	int retries = Probes;
+	size_t inFlight = max_probes_in_flight;
+	bool adaptive = retries <= 0;
+	if (adaptive)
+	{
+		auto connectionType = InternetConnectionState::GetConnectionType();
+		inFlight = (connectionType == ConnectionType::Cellular || connectionType == ConnectionType::WiFi) ? 2 : 4;
+		retries = max_adaptive_probes;
+	}
+
+	std::vector<HostName^> targets;
+	for (int i = 0; i < retries; ++i)
+	{
+		if (hosts.empty())
+		{
+			targets.push_back(ref new HostName(_socketTcpWellKnownHostNames[i % _socketTcpWellKnownHostNames->Length]));
+		}
+		else
+		{
+			targets.push_back(hosts[i % hosts.size()]);
+		}
+	}
+
+	//Nothing below blocks: every step is a continuation of the connects themselves...
+	ProbeEngine engine(inFlight, timeout);
+	auto round = adaptive ? engine.Run(targets, serviceName, SpeedBucketStopRule(min_adaptive_samples)) : engine.Run(targets, serviceName, (targets.size() + 1) / 2);
+	return round.then([self](std::vector<ProbeResult> results)
+	{
+		RttEstimator estimator;
+		RttEstimator ipv4;
+		RttEstimator ipv6;
+		RttEstimator dns;
+		RttEstimator overhead;
+		for (const auto& result : results)
+		{
+			if (result.Succeeded)
+			{
+				estimator.Add(result.Rtt);
+				if (result.Family == AddressFamily::Ipv4)
+				{
+					ipv4.Add(result.Rtt);
+				}
+				else if (result.Family == AddressFamily::Ipv6)
+				{
+					ipv6.Add(result.Rtt);
+				}
+				if (result.DnsLatency > 0.0)
+				{
+					dns.Add(result.DnsLatency);
+				}
+				overhead.Add(result.TimingOverhead);
+			}
+		}
+
+		//Compute speed from the median, which a single slow or failed probe cannot drag around...
+		SpeedMeasurement measurement = { ConnectionSpeed::Unknown, estimator.Median() };
+		if (estimator.Count() != 0 && measurement.RawSpeed != 0.0)
+		{
+			measurement.Speed = InternetConnectionState::GetConnectionSpeed(measurement.RawSpeed);
+		}
+
+		std::lock_guard<std::mutex> scopedLock(self->_lock);
+		self->_estimator = estimator;
+		self->_ipv4 = ipv4;
+		self->_ipv6 = ipv6;
+		self->_dns = dns;
+		self->_overhead = overhead;
+		self->_measurement = measurement;
+		return measurement;
+	});
+}
+
+IAsyncOperation<ConnectionSpeed>^ MeasurementSession::RunAsync()
+{
+	//build the chain inside the operation, so a synchronous failure faults it rather than throwing at the caller...
+	MeasurementSession^ self = this;
+	return create_async([self]() -> task<ConnectionSpeed>
+	{
+		return self->MeasureAsync().then([](SpeedMeasurement result)
+		{
+			return result.Speed;
+		});
+	});
+}
+
+ConnectionSpeed MeasurementSession::Speed::get()
+{
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	return _measurement.Speed;
+}
+
+double MeasurementSession::RawSpeed::get()
+{
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	return _measurement.RawSpeed;
+}
+
+double MeasurementSession::Jitter::get()
+{
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	return _estimator.Jitter();
+}
+
+int MeasurementSession::SampleCount::get()
+{
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	return static_cast<int>(_estimator.Count());
+}
+
+double MeasurementSession::Ipv4Rtt::get()
+{
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	return _ipv4.Median();
+}
+
+double MeasurementSession::Ipv6Rtt::get()
+{
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	return _ipv6.Median();
+}
+
+double MeasurementSession::DnsLatency::get()
+{
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	return _dns.Median();
+}
+
+double MeasurementSession::TimingOverhead::get()
+{
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	return _overhead.Median();
+}
+
+HostNameType MeasurementSession::WinningFamily::get()
+{
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	if (_ipv4.Count() == 0 && _ipv6.Count() == 0)
+	{
+		return HostNameType::DomainName;
+	}
+	return _ipv6.Count() >= _ipv4.Count() ? HostNameType::Ipv6 : HostNameType::Ipv4;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "pch.h"
+#include "Enums.h"
+#include "RttEstimator.h"
+#include "SpeedCache.h"
+
+#include <mutex>
+
+namespace InetSpeedUWP
+{
+	// One latency measurement that owns its targets, options and results.
+	// Sessions share no mutable state, so any number of them can run at once. The static methods on
+	// InternetConnectionState are thin wrappers that create a session per call.
+	// Options are read when RunAsync is called; changing them afterwards does not affect a measurement in flight.
+	public ref class MeasurementSession sealed
+	{
+	public:
+		MeasurementSession();
+		MeasurementSession(Windows::Networking::HostName^ hostName);
+
+		// Hosts to probe. When empty, a set of well-known hosts is used.
+		property Windows::Foundation::Collections::IVector<Windows::Networking::HostName^>^ Targets
+		{
+			Windows::Foundation::Collections::IVector<Windows::Networking::HostName^>^ get();
+		}
+
+		// Remote port or service name to connect to, "80" by default.
+		property Platform::String^ ServiceName;
+
+		// Number of probes, of which half must answer. 0 (the default) samples adaptively instead: probes run a few at
+		// a time (4 on LAN, 2 on WiFi or Cellular) and stop once the confidence interval of the RTT fits a single
+		// ConnectionSpeed bucket, after at most 8 probes.
+		property int Probes;
+
+		// How long a single probe may take before it is abandoned, 1 second by default. Targets with RTT history get
+		// a tighter connect timeout, SRTT + 4 * RTTVAR as TCP computes it, but never less than MinTimeout (50 ms by
+		// default); Timeout is the upper bound and what targets without history get.
+		property Windows::Foundation::TimeSpan Timeout;
+		property Windows::Foundation::TimeSpan MinTimeout;
+
+		Windows::Foundation::IAsyncOperation<ConnectionSpeed>^ RunAsync();
+
+		// Results of the last completed run.
+		property ConnectionSpeed Speed { ConnectionSpeed get(); }
+		property double RawSpeed { double get(); }
+		property double Jitter { double get(); }
+		property int SampleCount { int get(); }
+
+		// Median connect RTT of the probes each address family won, 0 if it won none.
+		property double Ipv4Rtt { double get(); }
+		property double Ipv6Rtt { double get(); }
+
+		// Median time spent resolving target names, 0 if every name came from the resolver cache.
+		// Name resolution is timed separately and never included in RawSpeed.
+		property double DnsLatency { double get(); }
+
+		// Median of how much longer connects took by a user-space clock than the stack-measured RTT, in seconds:
+		// the error RawSpeed would carry if it were timed around ConnectAsync instead.
+		property double TimingOverhead { double get(); }
+
+		// Address family that won most probes of the last run (Ipv6 on a tie), DomainName if none succeeded.
+		property Windows::Networking::HostNameType WinningFamily { Windows::Networking::HostNameType get(); }
+
+	internal:
+		concurrency::task<SpeedMeasurement> MeasureAsync();
+
+	private:
+		void SetDefaults();
+
+		Platform::Collections::Vector<Windows::Networking::HostName^>^ _targets;
+		std::mutex _lock;
+		SpeedMeasurement _measurement;
+		RttEstimator _estimator;
+		RttEstimator _ipv4;
+		RttEstimator _ipv6;
+		RttEstimator _dns;
+		RttEstimator _overhead;
+	};
+}
@@ -0,0 +1,61 @@
+#include "pch.h"
+#include "NetworkChangeMonitor.h"
+
+using namespace InetSpeedUWP;
+using namespace Platform;
+using namespace Windows::Networking::Connectivity;
+
+NetworkChangeMonitor& NetworkChangeMonitor::Instance()
+{
+	// Never destroyed: the network status handler may still fire while the module unloads.
+	static NetworkChangeMonitor* monitor = new NetworkChangeMonitor();
+	return *monitor;
+}
+
+NetworkChangeMonitor::NetworkChangeMonitor() :
+	_networkSignature(NetworkSignature())
+{
+	NetworkInformation::NetworkStatusChanged += ref new NetworkStatusChangedEventHandler([this](Object^)
+	{
+		OnNetworkStatusChanged();
+	});
+}
+
+//Same inputs GetConnectionType() looks at: the Internet profile and the interface type of its adapter...
+String^ NetworkChangeMonitor::NetworkSignature()
+{
+	auto profile = NetworkInformation::GetInternetConnectionProfile();
+	if (profile == nullptr || profile->NetworkAdapter == nullptr)
+	{
+		return "";
+	}
+
+	return profile->ProfileName + "|" + profile->NetworkAdapter->IanaInterfaceType.ToString() + "|" + profile->NetworkAdapter->NetworkAdapterId.ToString();
+}
+
+void NetworkChangeMonitor::Subscribe(Callback onChange)
+{
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	_subscribers.push_back(onChange);
+}
+
+void NetworkChangeMonitor::OnNetworkStatusChanged()
+{
+	auto signature = NetworkSignature();
+	std::vector<Callback> subscribers;
+	{
+		std::lock_guard<std::mutex> scopedLock(_lock);
+		if (String::Equals(signature, _networkSignature))
+		{
+			return;
+		}
+		_networkSignature = signature;
+		subscribers = _subscribers;
+	}
+
+	//a subscriber may take its own lock, never call it with ours held...
+	for (const auto& onChange : subscribers)
+	{
+		onChange();
+	}
+}
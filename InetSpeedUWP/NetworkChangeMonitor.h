@@ -0,0 +1,35 @@
+#pragma once
+#include "pch.h"
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace InetSpeedUWP
+{
+	// Process-wide watch on the network measurements run over, shared by the caches that must forget it.
+	// NetworkStatusChanged also fires for changes that leave the path alone (cost, signal, another adapter),
+	// so subscribers are only called when the Internet connection profile, the interface type of its adapter
+	// or the adapter itself changed. Callbacks run on the thread raising the event, without any lock held.
+	class NetworkChangeMonitor
+	{
+	public:
+		typedef std::function<void()> Callback;
+
+		static NetworkChangeMonitor& Instance();
+
+		void Subscribe(Callback onChange);
+
+	private:
+		NetworkChangeMonitor();
+		NetworkChangeMonitor(const NetworkChangeMonitor&) = delete;
+		NetworkChangeMonitor& operator=(const NetworkChangeMonitor&) = delete;
+
+		void OnNetworkStatusChanged();
+		static Platform::String^ NetworkSignature();
+
+		std::mutex _lock;
+		Platform::String^ _networkSignature;
+		std::vector<Callback> _subscribers;
+	};
+}
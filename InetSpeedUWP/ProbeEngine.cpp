@@ -0,0 +1,202 @@
+#include "pch.h"
+#include "ProbeEngine.h"
+#include "TimeoutPolicy.h"
+#include "pplpp.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+
+using namespace InetSpeedUWP;
+using namespace Concurrency;
+using namespace Platform;
+using namespace Windows::Networking;
+using namespace Windows::Networking::Sockets;
+using namespace pplpp;
+
+namespace
+{
+	// Shared state of one Run() call; every probe continuation holds a reference to it.
+	struct ProbeRound
+	{
+		std::mutex lock;
+		std::vector<HostName^> targets;
+		String^ serviceName;
+		TimeoutBounds timeout;
+		std::shared_ptr<ConnectBackend> backend;
+		size_t maxInFlight;
+		ProbeEngine::StopCondition stop;
+		size_t next;
+		size_t pending;
+		bool completed;
+		std::vector<ProbeResult> results;
+		task_completion_event<std::vector<ProbeResult>> done;
+		cancellation_token_source cts;
+	};
+
+	void LaunchProbe(std::shared_ptr<ProbeRound> round, HostName^ target);
+
+	std::wstring ToWide(String^ value)
+	{
+		return value == nullptr ? std::wstring() : std::wstring(value->Data(), value->Length());
+	}
+
+	//Caller must hold round.lock...
+	std::vector<HostName^> TakeLaunchable(ProbeRound& round)
+	{
+		std::vector<HostName^> launchable;
+		while (round.pending < round.maxInFlight && round.next < round.targets.size())
+		{
+			launchable.push_back(round.targets[round.next++]);
+			round.pending++;
+		}
+		return launchable;
+	}
+
+	void OnProbeFinished(std::shared_ptr<ProbeRound> round, const ProbeResult& result)
+	{
+		std::vector<HostName^> launchable;
+		bool finished = false;
+		{
+			std::lock_guard<std::mutex> scopedLock(round->lock);
+			round->pending--;
+			if (round->completed)
+			{
+				return;
+			}
+
+			round->results.push_back(result);
+			if (round->stop(round->results) || (round->next == round->targets.size() && round->pending == 0))
+			{
+				round->completed = true;
+				finished = true;
+			}
+			else
+			{
+				launchable = TakeLaunchable(*round);
+			}
+		}
+
+		if (finished)
+		{
+			//enough samples, stop whatever is still connecting...
+			round->cts.cancel();
+			round->done.set(round->results);
+			return;
+		}
+
+		for (auto target : launchable)
+		{
+			LaunchProbe(round, target);
+		}
+	}
+
+	void LaunchProbe(std::shared_ptr<ProbeRound> round, HostName^ target)
+	{
+		//the connect gets a timeout from the target's RTT history, the whole probe (name resolution included)
+		//must complete within the upper bound, cancel otherwise..
+		auto connectTimeout = TimeoutPolicy::Instance().Timeout(target->CanonicalName, round->timeout);
+		timed_cancellation_token_source tcs;
+		auto timeout = tcs.cancel(round->timeout.Max);
+		std::vector<cancellation_token> tokens = { tcs.get_token(), round->cts.get_token() };
+		auto probeToken = cancellation_token_source::create_linked_source(tokens.begin(), tokens.end()).get_token();
+
+		task<ConnectSample> connecting;
+		try
+		{
+			connecting = round->backend->Connect(ToWide(target->CanonicalName), ToWide(round->serviceName), probeToken, connectTimeout);
+		}
+		catch (Platform::COMException^ e) //refused before it started, finish it like any other failed probe...
+		{
+			connecting = task_from_exception<ConnectSample>(e);
+		}
+
+		connecting.then([round, target, timeout](task<ConnectSample> connect)
+		{
+			//the connect is over one way or another, release its timer now rather than when it would have fired...
+			timeout.disarm();
+
+			ProbeResult result = { target->CanonicalName, 0.0, false, AddressFamily::Unknown, 0.0, 0.0 };
+			try
+			{
+				auto sample = connect.get();
+				result.Rtt = sample.Rtt;
+				result.Family = sample.Family;
+				result.DnsLatency = sample.DnsLatency;
+				result.TimingOverhead = std::max(sample.ConnectTime - sample.Rtt, 0.0);
+				result.Succeeded = true;
+				TimeoutPolicy::Instance().OnSample(target->CanonicalName, result.Rtt);
+			}
+			catch (Platform::COMException^) //naughty, but sometimes this happens and should not crash this component...
+			{
+			}
+			catch (task_canceled&) //probe timeout exceeded, or the round already has enough samples...
+			{
+				if (!round->cts.get_token().is_canceled())
+				{
+					TimeoutPolicy::Instance().OnTimeout(target->CanonicalName);
+				}
+			}
+
+			OnProbeFinished(round, result);
+		});
+	}
+}
+
+ProbeEngine::ProbeEngine(size_t maxInFlight, std::chrono::milliseconds timeout) :
+	_maxInFlight(std::max<size_t>(maxInFlight, 1)),
+	_backend(std::make_shared<StreamSocketBackend>())
+{
+	_timeout.Min = timeout;
+	_timeout.Max = timeout;
+}
+
+ProbeEngine::ProbeEngine(size_t maxInFlight, TimeoutBounds timeout, std::shared_ptr<ConnectBackend> backend) :
+	_maxInFlight(std::max<size_t>(maxInFlight, 1)),
+	_timeout(timeout),
+	_backend(backend != nullptr ? backend : std::make_shared<StreamSocketBackend>())
+{
+	_timeout.Min = std::min(_timeout.Min, _timeout.Max);
+}
+
+task<std::vector<ProbeResult>> ProbeEngine::Run(const std::vector<HostName^>& targets, String^ serviceName, size_t requiredSamples) const
+{
+	auto required = std::min(std::max<size_t>(requiredSamples, 1), targets.size());
+	return Run(targets, serviceName, [required](const std::vector<ProbeResult>& results)
+	{
+		return static_cast<size_t>(std::count_if(results.begin(), results.end(), [](const ProbeResult& result) { return result.Succeeded; })) >= required;
+	});
+}
+
+task<std::vector<ProbeResult>> ProbeEngine::Run(const std::vector<HostName^>& targets, String^ serviceName, StopCondition stop) const
+{
+	if (targets.empty())
+	{
+		return task_from_result(std::vector<ProbeResult>());
+	}
+
+	auto round = std::make_shared<ProbeRound>();
+	round->targets = targets;
+	round->serviceName = serviceName;
+	round->timeout = _timeout;
+	round->backend = _backend;
+	round->maxInFlight = _maxInFlight;
+	round->stop = stop;
+	round->next = 0;
+	round->pending = 0;
+	round->completed = false;
+
+	std::vector<HostName^> launchable;
+	{
+		std::lock_guard<std::mutex> scopedLock(round->lock);
+		launchable = TakeLaunchable(*round);
+	}
+
+	for (auto target : launchable)
+	{
+		LaunchProbe(round, target);
+	}
+
+	return create_task(round->done);
+}
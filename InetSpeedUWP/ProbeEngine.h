@@ -0,0 +1,51 @@
+#pragma once
+#include "pch.h"
+#include "ConnectBackend.h"
+#include "TimeoutPolicy.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace InetSpeedUWP
+{
+	// Outcome of a single connect probe. Rtt (see ConnectSample) is in seconds and only meaningful when
+	// Succeeded is true; Family is the address family that won the dual-stack race, and
+	// DnsLatency the time spent resolving the target beforehand (0 when it came from the ResolverCache).
+	// TimingOverhead is how much longer the connect looked from user space than the handshake RTT the stack
+	// measured, i.e. the error the stack's timestamps removed.
+	struct ProbeResult
+	{
+		Platform::String^ Target;
+		double Rtt;
+		bool Succeeded;
+		AddressFamily Family;
+		double DnsLatency;
+		double TimingOverhead;
+	};
+
+	// Connects to a set of targets concurrently instead of one after the other.
+	// At most maxInFlight connects are outstanding at any time, and the round completes as soon as
+	// requiredSamples probes have succeeded, or a stop condition evaluated after every probe says so
+	// (or every probe has finished). Probes still outstanding at that point are cancelled so their sockets
+	// close right away. With timeout bounds, each connect gets a timeout from the target's RTT history
+	// (see TimeoutPolicy) instead of a fixed one. Connects go through a ConnectBackend, StreamSocketBackend
+	// unless another one is given.
+	class ProbeEngine
+	{
+	public:
+		typedef std::function<bool(const std::vector<ProbeResult>&)> StopCondition;
+
+		ProbeEngine(size_t maxInFlight, std::chrono::milliseconds timeout);
+		ProbeEngine(size_t maxInFlight, TimeoutBounds timeout, std::shared_ptr<ConnectBackend> backend = nullptr);
+
+		concurrency::task<std::vector<ProbeResult>> Run(const std::vector<Windows::Networking::HostName^>& targets, Platform::String^ serviceName, size_t requiredSamples) const;
+		concurrency::task<std::vector<ProbeResult>> Run(const std::vector<Windows::Networking::HostName^>& targets, Platform::String^ serviceName, StopCondition stop) const;
+
+	private:
+		size_t _maxInFlight;
+		TimeoutBounds _timeout;
+		std::shared_ptr<ConnectBackend> _backend;
+	};
+}
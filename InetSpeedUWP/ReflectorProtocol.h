@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+
+namespace InetSpeedUWP
+{
+	// Wire protocol spoken between the measurement client and ReflectorServer.
+	// A client opens a TCP connection and sends a single command byte that selects what the server does with it,
+	// or sends UDP probes to the same port.
+	namespace ReflectorProtocol
+	{
+		// Server streams data to the client until the client disconnects.
+		const unsigned char SourceCommand = 'S';
+		// Server reads and throws away everything the client sends.
+		const unsigned char DiscardCommand = 'D';
+		// Server sends back everything the client sends.
+		const unsigned char EchoCommand = 'E';
+
+		// Echo clients send fixed-size frames, a 64-bit sequence number followed by a 64-bit send timestamp,
+		// and read each one back before sending the next on that connection.
+		const unsigned int EchoFrameSize = 16;
+
+		// UDP probes (TWAMP-light) go to the same port number. A probe is four 64-bit fields: sequence number,
+		// sender transmit time, reflector receive time and reflector transmit time, each side stamping times in
+		// nanoseconds on its own clock. The sender fills the first two; the reflector fills the rest and sends
+		// the datagram back.
+		const unsigned int UdpProbeSize = 32;
+
+		// Size of the buffers moved on each read or write.
+		const unsigned int ChunkSize = 64 * 1024;
+
+		// Clock both sides take their timestamps from.
+		typedef std::chrono::steady_clock clock_type;
+
+		// Current time on clock_type in nanoseconds, as echo frames and UDP probes carry it.
+		inline unsigned long long Timestamp()
+		{
+			return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now().time_since_epoch()).count());
+		}
+	}
+}
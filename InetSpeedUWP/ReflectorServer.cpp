@@ -0,0 +1,425 @@
+#include "pch.h"
+#include "ReflectorServer.h"
+#include "ReflectorProtocol.h"
+#include "pplpp.h"
+
+#include <algorithm>
+#include <mutex>
+#include <random>
+
+using namespace InetSpeedUWP;
+using namespace Concurrency;
+using namespace Platform;
+using namespace Windows::Foundation;
+using namespace Windows::Networking::Sockets;
+using namespace Windows::Storage::Streams;
+using namespace pplpp;
+
+namespace InetSpeedUWP
+{
+	struct Impairment
+	{
+		int DelayMilliseconds;
+		int JitterMilliseconds;
+		double BandwidthBitsPerSecond;
+		double DropRate;
+	};
+
+	struct ReflectorSettings
+	{
+		std::mutex Lock;
+		Impairment Current;
+		DatagramSocket^ BoundDatagram;
+		unsigned int Seed;
+		//seeds the shapers, so a fixed Seed makes a whole run repeat...
+		std::mt19937 Random;
+	};
+}
+
+namespace
+{
+	using ReflectorProtocol::clock_type;
+	using ReflectorProtocol::Timestamp;
+
+	// Applies one snapshot of the impairment settings to a single connection, or to the datagrams of one socket.
+	class ConnectionShaper
+	{
+	public:
+		ConnectionShaper(const Impairment& impairment, unsigned int seed) :
+			_impairment(impairment),
+			_random(seed),
+			_start(clock_type::now()),
+			_bytes(0)
+		{
+		}
+
+		void Update(const Impairment& impairment)
+		{
+			_impairment = impairment;
+		}
+
+		bool ShouldDrop()
+		{
+			return _impairment.DropRate > 0.0 && std::uniform_real_distribution<double>(0.0, 1.0)(_random) < _impairment.DropRate;
+		}
+
+		std::chrono::milliseconds Latency()
+		{
+			int latency = _impairment.DelayMilliseconds;
+			if (_impairment.JitterMilliseconds > 0)
+			{
+				latency += std::uniform_int_distribution<int>(-_impairment.JitterMilliseconds, _impairment.JitterMilliseconds)(_random);
+			}
+			return std::chrono::milliseconds(std::max(latency, 0));
+		}
+
+		// How long to hold off after moving bytes so the connection stays under its bandwidth cap.
+		std::chrono::milliseconds Pace(unsigned int bytes)
+		{
+			if (_impairment.BandwidthBitsPerSecond <= 0.0)
+			{
+				return std::chrono::milliseconds(0);
+			}
+
+			_bytes += bytes;
+			auto due = _start + std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(_bytes * 8.0 / _impairment.BandwidthBitsPerSecond));
+			auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(due - clock_type::now());
+			return std::max(wait, std::chrono::milliseconds(0));
+		}
+
+	private:
+		Impairment _impairment;
+		std::mt19937 _random;
+		clock_type::time_point _start;
+		unsigned long long _bytes;
+	};
+
+	task<void> Pause(std::chrono::milliseconds delay)
+	{
+		return delay.count() > 0 ? create_timer_task(delay) : task_from_result();
+	}
+
+	task<void> RunSource(StreamSocket^ socket, std::shared_ptr<ConnectionShaper> shaper)
+	{
+		auto buffer = ref new Buffer(ReflectorProtocol::ChunkSize);
+		buffer->Length = ReflectorProtocol::ChunkSize;
+		return create_iterative_task([socket, shaper, buffer]
+		{
+			return create_task(socket->OutputStream->WriteAsync(buffer)).then([shaper](unsigned int written)
+			{
+				return Pause(shaper->Pace(written)).then([written]
+				{
+					return written > 0;
+				});
+			});
+		});
+	}
+
+	task<void> RunDiscard(StreamSocket^ socket, std::shared_ptr<ConnectionShaper> shaper)
+	{
+		auto buffer = ref new Buffer(ReflectorProtocol::ChunkSize);
+		return create_iterative_task([socket, shaper, buffer]
+		{
+			return create_task(socket->InputStream->ReadAsync(buffer, ReflectorProtocol::ChunkSize, InputStreamOptions::Partial)).then([shaper](IBuffer^ read)
+			{
+				auto length = read->Length;
+				return Pause(shaper->Pace(length)).then([length]
+				{
+					return length > 0;
+				});
+			});
+		});
+	}
+
+	task<void> RunEcho(StreamSocket^ socket, std::shared_ptr<ConnectionShaper> shaper)
+	{
+		auto buffer = ref new Buffer(ReflectorProtocol::ChunkSize);
+		return create_iterative_task([socket, shaper, buffer]
+		{
+			return create_task(socket->InputStream->ReadAsync(buffer, ReflectorProtocol::ChunkSize, InputStreamOptions::Partial)).then([socket, shaper](IBuffer^ read)
+			{
+				if (read->Length == 0)
+				{
+					return task_from_result(false);
+				}
+
+				return Pause(shaper->Latency()).then([socket, read]
+				{
+					return create_task(socket->OutputStream->WriteAsync(read));
+				}).then([shaper](unsigned int written)
+				{
+					return Pause(shaper->Pace(written)).then([]
+					{
+						return true;
+					});
+				});
+			});
+		});
+	}
+
+	void OnProbeReceived(DatagramSocket^ socket, DatagramSocketMessageReceivedEventArgs^ args, std::chrono::milliseconds latency)
+	{
+		auto reader = args->GetDataReader();
+		if (reader->UnconsumedBufferLength < ReflectorProtocol::UdpProbeSize)
+		{
+			return;
+		}
+
+		auto sequence = reader->ReadUInt64();
+		auto sent = reader->ReadUInt64();
+
+		//the injected delay stands for the path, so the probe is stamped as received only once it is over...
+		auto remoteAddress = args->RemoteAddress;
+		auto remotePort = args->RemotePort;
+		auto received = std::make_shared<unsigned long long>(0);
+		Pause(latency).then([socket, remoteAddress, remotePort, received]
+		{
+			*received = Timestamp();
+			return create_task(socket->GetOutputStreamAsync(remoteAddress, remotePort));
+		}).then([sequence, sent, received](IOutputStream^ stream)
+		{
+			auto writer = ref new DataWriter(stream);
+			writer->WriteUInt64(sequence);
+			writer->WriteUInt64(sent);
+			writer->WriteUInt64(*received);
+			writer->WriteUInt64(Timestamp());
+			return create_task(writer->StoreAsync());
+		}).then([](task<unsigned int> reflected)
+		{
+			try
+			{
+				reflected.get();
+			}
+			catch (Platform::COMException^) //the sender went away, nothing to reflect to...
+			{
+			}
+			catch (task_canceled&)
+			{
+			}
+		});
+	}
+
+	void OnConnectionReceived(StreamSocket^ socket, const Impairment& impairment, unsigned int seed)
+	{
+		auto shaper = std::make_shared<ConnectionShaper>(impairment, seed);
+		if (shaper->ShouldDrop())
+		{
+			delete socket;
+			return;
+		}
+
+		auto reader = ref new DataReader(socket->InputStream);
+		create_task(reader->LoadAsync(1)).then([socket, reader, shaper](unsigned int loaded)
+		{
+			auto command = loaded == 1 ? reader->ReadByte() : 0;
+			reader->DetachStream();
+
+			if (command == ReflectorProtocol::EchoCommand)
+			{
+				return RunEcho(socket, shaper);
+			}
+
+			auto session = command == ReflectorProtocol::SourceCommand ? &RunSource : command == ReflectorProtocol::DiscardCommand ? &RunDiscard : nullptr;
+			if (session == nullptr)
+			{
+				return task_from_result();
+			}
+
+			return Pause(shaper->Latency()).then([session, socket, shaper]
+			{
+				return session(socket, shaper);
+			});
+		}).then([socket](task<void> session)
+		{
+			try
+			{
+				session.get();
+			}
+			catch (Platform::COMException^) //the client went away, which is how every session ends...
+			{
+			}
+			catch (task_canceled&)
+			{
+			}
+			delete socket;
+		});
+	}
+}
+
+ReflectorServer::ReflectorServer() :
+	_settings(std::make_shared<ReflectorSettings>())
+{
+	Impairment none = { 0, 0, 0.0, 0.0 };
+	_settings->Current = none;
+	_settings->Seed = 0;
+}
+
+ReflectorServer::~ReflectorServer()
+{
+	Stop();
+}
+
+IAsyncAction^ ReflectorServer::StartAsync(String^ serviceName)
+{
+	Stop();
+
+	auto settings = _settings;
+	std::shared_ptr<ConnectionShaper> probeShaper;
+	{
+		std::lock_guard<std::mutex> scopedLock(settings->Lock);
+		settings->Random.seed(settings->Seed != 0 ? settings->Seed : std::random_device()());
+		probeShaper = std::make_shared<ConnectionShaper>(settings->Current, settings->Random());
+	}
+
+	_listener = ref new StreamSocketListener();
+	_listener->ConnectionReceived += ref new TypedEventHandler<StreamSocketListener^, StreamSocketListenerConnectionReceivedEventArgs^>(
+		[settings](StreamSocketListener^, StreamSocketListenerConnectionReceivedEventArgs^ args)
+	{
+		Impairment impairment;
+		unsigned int seed;
+		{
+			std::lock_guard<std::mutex> scopedLock(settings->Lock);
+			impairment = settings->Current;
+			seed = settings->Random();
+		}
+		OnConnectionReceived(args->Socket, impairment, seed);
+	});
+
+	//datagrams share one shaper, drawn from under the settings lock since receives may overlap...
+	_datagram = ref new DatagramSocket();
+	_datagram->MessageReceived += ref new TypedEventHandler<DatagramSocket^, DatagramSocketMessageReceivedEventArgs^>(
+		[settings, probeShaper](DatagramSocket^ socket, DatagramSocketMessageReceivedEventArgs^ args)
+	{
+		bool drop;
+		std::chrono::milliseconds latency;
+		{
+			std::lock_guard<std::mutex> scopedLock(settings->Lock);
+			probeShaper->Update(settings->Current);
+			drop = probeShaper->ShouldDrop();
+			latency = probeShaper->Latency();
+		}
+		if (drop)
+		{
+			return;
+		}
+
+		try
+		{
+			OnProbeReceived(socket, args, latency);
+		}
+		catch (Platform::COMException^) //ICMP port unreachable from a sender that already closed its socket...
+		{
+		}
+	});
+
+	//UDP probes share the TCP port, which is only known once the listener is bound...
+	auto listener = _listener;
+	auto datagram = _datagram;
+	return create_async([listener, datagram, settings, serviceName]
+	{
+		return create_task(listener->BindServiceNameAsync(serviceName == nullptr ? "" : serviceName)).then([listener, datagram, settings]
+		{
+			return create_task(datagram->BindServiceNameAsync(listener->Information->LocalPort)).then([datagram, settings](task<void> bound)
+			{
+				try
+				{
+					bound.get();
+					std::lock_guard<std::mutex> scopedLock(settings->Lock);
+					settings->BoundDatagram = datagram;
+				}
+				catch (Platform::COMException^) //the UDP port is taken, the TCP modes keep running without it...
+				{
+					delete datagram;
+				}
+			});
+		});
+	});
+}
+
+void ReflectorServer::Stop()
+{
+	if (_listener != nullptr)
+	{
+		delete _listener;
+		_listener = nullptr;
+	}
+	if (_datagram != nullptr)
+	{
+		delete _datagram;
+		_datagram = nullptr;
+	}
+
+	std::lock_guard<std::mutex> scopedLock(_settings->Lock);
+	_settings->BoundDatagram = nullptr;
+}
+
+String^ ReflectorServer::ServiceName::get()
+{
+	return _listener == nullptr ? nullptr : _listener->Information->LocalPort;
+}
+
+bool ReflectorServer::ReflectsUdp::get()
+{
+	std::lock_guard<std::mutex> scopedLock(_settings->Lock);
+	return _datagram != nullptr && _settings->BoundDatagram == _datagram;
+}
+
+int ReflectorServer::DelayMilliseconds::get()
+{
+	std::lock_guard<std::mutex> scopedLock(_settings->Lock);
+	return _settings->Current.DelayMilliseconds;
+}
+
+void ReflectorServer::DelayMilliseconds::set(int value)
+{
+	std::lock_guard<std::mutex> scopedLock(_settings->Lock);
+	_settings->Current.DelayMilliseconds = std::max(value, 0);
+}
+
+int ReflectorServer::JitterMilliseconds::get()
+{
+	std::lock_guard<std::mutex> scopedLock(_settings->Lock);
+	return _settings->Current.JitterMilliseconds;
+}
+
+void ReflectorServer::JitterMilliseconds::set(int value)
+{
+	std::lock_guard<std::mutex> scopedLock(_settings->Lock);
+	_settings->Current.JitterMilliseconds = std::max(value, 0);
+}
+
+double ReflectorServer::BandwidthBitsPerSecond::get()
+{
+	std::lock_guard<std::mutex> scopedLock(_settings->Lock);
+	return _settings->Current.BandwidthBitsPerSecond;
+}
+
+void ReflectorServer::BandwidthBitsPerSecond::set(double value)
+{
+	std::lock_guard<std::mutex> scopedLock(_settings->Lock);
+	_settings->Current.BandwidthBitsPerSecond = std::max(value, 0.0);
+}
+
+double ReflectorServer::DropRate::get()
+{
+	std::lock_guard<std::mutex> scopedLock(_settings->Lock);
+	return _settings->Current.DropRate;
+}
+
+void ReflectorServer::DropRate::set(double value)
+{
+	std::lock_guard<std::mutex> scopedLock(_settings->Lock);
+	_settings->Current.DropRate = std::min(std::max(value, 0.0), 1.0);
+}
+
+unsigned int ReflectorServer::Seed::get()
+{
+	std::lock_guard<std::mutex> scopedLock(_settings->Lock);
+	return _settings->Seed;
+}
+
+void ReflectorServer::Seed::set(unsigned int value)
+{
+	std::lock_guard<std::mutex> scopedLock(_settings->Lock);
+	_settings->Seed = value;
+}
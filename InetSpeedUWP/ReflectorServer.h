@@ -0,0 +1,49 @@
+#pragma once
+#include "pch.h"
+
+#include <memory>
+
+namespace InetSpeedUWP
+{
+	struct ReflectorSettings;
+
+	// Local stand-in for the well-known hosts (see ReflectorProtocol.h): sources, discards or echoes data,
+	// optionally with injected per-connection delay, jitter, bandwidth caps and dropped connections, and reflects
+	// UDP probes on the same port with the same delay, jitter and drop rate applied per datagram.
+	// Run it on another machine, or in-process on loopback, and point the measurement APIs at it.
+	// Impairment settings apply to connections accepted, and datagrams received, after they are changed.
+	public ref class ReflectorServer sealed
+	{
+	public:
+		ReflectorServer();
+		~ReflectorServer();
+
+		// Starts listening; pass an empty service name to let the system pick a free port. UDP probes are reflected
+		// on the same port number; if that UDP port is taken, the TCP modes run without them (see ReflectsUdp).
+		Windows::Foundation::IAsyncAction^ StartAsync(Platform::String^ serviceName);
+		void Stop();
+
+		// The port the server is listening on, or nullptr if it has not been started.
+		property Platform::String^ ServiceName { Platform::String^ get(); }
+		// Whether UDP probes are being reflected.
+		property bool ReflectsUdp { bool get(); }
+
+		// Delay added before every echo reply and reflected UDP probe, and before a source or discard session starts.
+		property int DelayMilliseconds { int get(); void set(int value); }
+		// Random variation added to or subtracted from the delay.
+		property int JitterMilliseconds { int get(); void set(int value); }
+		// Per-connection bandwidth cap in bits per second; 0 means unlimited.
+		property double BandwidthBitsPerSecond { double get(); void set(double value); }
+		// Fraction of incoming connections, between 0 and 1, closed right after they are accepted, and of UDP probes
+		// dropped without a reply.
+		property double DropRate { double get(); void set(double value); }
+		// Seed for the random drops and jitter, taken at the next StartAsync; 0 (the default) picks a random seed.
+		// With a fixed seed, the same sequence of connections and datagrams sees the same impairments.
+		property unsigned int Seed { unsigned int get(); void set(unsigned int value); }
+
+	private:
+		Windows::Networking::Sockets::StreamSocketListener^ _listener;
+		Windows::Networking::Sockets::DatagramSocket^ _datagram;
+		std::shared_ptr<ReflectorSettings> _settings;
+	};
+}
@@ -0,0 +1,180 @@
+#include "pch.h"
+#include "ResolverCache.h"
+#include "NetworkChangeMonitor.h"
+
+#include <set>
+
+using namespace InetSpeedUWP;
+using namespace Concurrency;
+using namespace Platform;
+using namespace Windows::Foundation::Collections;
+using namespace Windows::Networking;
+using namespace Windows::Networking::Sockets;
+
+const long long default_resolver_ttl_ms = 60000;
+
+namespace
+{
+	//RFC 8305 section 4: alternate families, starting with IPv6, keeping the resolver's order within a family...
+	std::vector<HostName^> InterleaveFamilies(IVectorView<EndpointPair^>^ pairs)
+	{
+		std::vector<HostName^> ipv6;
+		std::vector<HostName^> ipv4;
+		std::set<std::wstring> seen;
+		for (auto pair : pairs)
+		{
+			auto address = pair->RemoteHostName;
+			if (address == nullptr || !seen.insert(address->CanonicalName->Data()).second)
+			{
+				continue;
+			}
+
+			if (address->Type == HostNameType::Ipv6)
+			{
+				ipv6.push_back(address);
+			}
+			else if (address->Type == HostNameType::Ipv4)
+			{
+				ipv4.push_back(address);
+			}
+		}
+
+		std::vector<HostName^> ordered;
+		for (size_t i = 0; i < ipv6.size() || i < ipv4.size(); ++i)
+		{
+			if (i < ipv6.size())
+			{
+				ordered.push_back(ipv6[i]);
+			}
+			if (i < ipv4.size())
+			{
+				ordered.push_back(ipv4[i]);
+			}
+		}
+		return ordered;
+	}
+}
+
+ResolverCache& ResolverCache::Instance()
+{
+	static ResolverCache* cache = new ResolverCache();
+	return *cache;
+}
+
+ResolverCache::ResolverCache() :
+	_generation(0),
+	_timeToLive(default_resolver_ttl_ms)
+{
+	//another network may bring a different DNS server or address family, resolve again...
+	NetworkChangeMonitor::Instance().Subscribe([this]
+	{
+		Invalidate();
+	});
+}
+
+void ResolverCache::Invalidate()
+{
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	_entries.clear();
+	_generation++;
+}
+
+task<Resolution> ResolverCache::Resolve(HostName^ hostName, String^ serviceName)
+{
+	//address literals need no resolution...
+	if (hostName->Type == HostNameType::Ipv4 || hostName->Type == HostNameType::Ipv6)
+	{
+		Resolution literal;
+		literal.Addresses.push_back(hostName);
+		literal.Latency = 0.0;
+		return task_from_result(literal);
+	}
+
+	std::wstring key(hostName->CanonicalName->Data());
+	key += L"|";
+	key += serviceName == nullptr ? L"" : serviceName->Data();
+	auto now = clock_type::now();
+
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	auto& entry = _entries[key];
+	if (entry.Valid && now - entry.Resolved < _timeToLive)
+	{
+		Resolution cached;
+		cached.Addresses = entry.Addresses;
+		cached.Latency = 0.0;
+		return task_from_result(cached);
+	}
+
+	if (entry.Resolving)
+	{
+		return entry.InFlight;
+	}
+	return StartLookup(key, entry, hostName, serviceName);
+}
+
+//Caller must hold _lock...
+task<Resolution> ResolverCache::StartLookup(const std::wstring& key, Entry& entry, HostName^ hostName, String^ serviceName)
+{
+	auto generation = _generation;
+	auto started = clock_type::now();
+	task<IVectorView<EndpointPair^>^> resolving;
+	try
+	{
+		resolving = create_task(DatagramSocket::GetEndpointPairsAsync(hostName, serviceName));
+	}
+	catch (Platform::COMException^ e) //refused before it started, leave nothing behind for the next caller to wait on...
+	{
+		_entries.erase(key);
+		return task_from_exception<Resolution>(e);
+	}
+
+	entry.Resolving = true;
+	entry.InFlight = resolving.then([this, key, generation, started](task<IVectorView<EndpointPair^>^> lookup)
+	{
+		std::lock_guard<std::mutex> scopedLock(_lock);
+		auto found = _entries.find(key);
+		bool current = generation == _generation && found != _entries.end();
+		try
+		{
+			Resolution resolution;
+			resolution.Addresses = InterleaveFamilies(lookup.get());
+			resolution.Latency = std::chrono::duration<double>(clock_type::now() - started).count();
+			if (current)
+			{
+				found->second.Resolving = false;
+				if (!resolution.Addresses.empty())
+				{
+					found->second.Valid = true;
+					found->second.Addresses = resolution.Addresses;
+					found->second.Resolved = clock_type::now();
+				}
+			}
+			return resolution;
+		}
+		catch (...) //whatever the failure, the entry must not stay marked in flight...
+		{
+			if (current)
+			{
+				found->second.Resolving = false;
+				if (!found->second.Valid)
+				{
+					_entries.erase(found);
+				}
+			}
+			throw;
+		}
+	}, task_continuation_context::use_arbitrary());
+	return entry.InFlight;
+}
+
+std::chrono::milliseconds ResolverCache::TimeToLive()
+{
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	return _timeToLive;
+}
+
+void ResolverCache::SetTimeToLive(std::chrono::milliseconds timeToLive)
+{
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	_timeToLive = timeToLive;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "pch.h"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace InetSpeedUWP
+{
+	// Addresses of one host, in connect order (families interleaved, IPv6 first as RFC 8305 asks).
+	// Latency is how long the lookup took in seconds, 0 when the answer came from the cache.
+	struct Resolution
+	{
+		std::vector<Windows::Networking::HostName^> Addresses;
+		double Latency;
+	};
+
+	// Process-wide cache of name resolutions, so connect RTT is always measured against a pre-resolved address
+	// and name resolution is timed on its own. Each host:service pair is resolved once; concurrent callers share
+	// the lookup in flight. The platform resolver does not expose record TTLs, so answers are kept for a fixed,
+	// configurable time-to-live instead, and everything is dropped when NetworkChangeMonitor reports a new network.
+	// Failed or empty lookups are not cached.
+	class ResolverCache
+	{
+	public:
+		static ResolverCache& Instance();
+
+		concurrency::task<Resolution> Resolve(Windows::Networking::HostName^ hostName, Platform::String^ serviceName);
+		void Invalidate();
+
+		std::chrono::milliseconds TimeToLive();
+		void SetTimeToLive(std::chrono::milliseconds timeToLive);
+
+	private:
+		typedef std::chrono::steady_clock clock_type;
+
+		struct Entry
+		{
+			Entry() : Valid(false), Resolving(false) {}
+
+			bool Valid;
+			std::vector<Windows::Networking::HostName^> Addresses;
+			clock_type::time_point Resolved;
+			bool Resolving;
+			concurrency::task<Resolution> InFlight;
+		};
+
+		ResolverCache();
+		ResolverCache(const ResolverCache&) = delete;
+		ResolverCache& operator=(const ResolverCache&) = delete;
+
+		concurrency::task<Resolution> StartLookup(const std::wstring& key, Entry& entry, Windows::Networking::HostName^ hostName, Platform::String^ serviceName);
+
+		std::mutex _lock;
+		std::map<std::wstring, Entry> _entries;
+		unsigned long long _generation;
+		std::chrono::milliseconds _timeToLive;
+	};
+}
@@ -0,0 +1,215 @@
+#include "pch.h"
+#include "RttEstimator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace InetSpeedUWP;
+
+const size_t RttEstimator::window_size;
+const size_t RttEstimator::min_samples_for_rejection;
+const size_t RttEstimator::histogram_buckets;
+
+// Bucket 0 holds everything under a microsecond; 1.04 apart, the other buckets reach past 100 seconds.
+const double RttEstimator::histogram_floor = 1e-6;
+const double RttEstimator::histogram_growth = 1.04;
+
+// Iglewicz and Hoaglin's cut-off for the modified z-score 0.6745 * (x - median) / MAD.
+const double RttEstimator::outlier_threshold = 3.5;
+
+RttEstimator::RttEstimator()
+{
+	Reset();
+}
+
+void RttEstimator::Reset()
+{
+	_window.fill(0.0);
+	_windowNext = 0;
+	_windowCount = 0;
+	_histogram.fill(0);
+	_count = 0;
+	_accepted = 0;
+	_min = std::numeric_limits<double>::infinity();
+	_max = 0.0;
+	_mean = 0.0;
+	_m2 = 0.0;
+	_last = 0.0;
+	_jitterSum = 0.0;
+}
+
+bool RttEstimator::Add(double rtt)
+{
+	if (!(rtt >= 0.0) || std::isinf(rtt))
+	{
+		return false;
+	}
+
+	bool accepted = true;
+	if (_windowCount >= min_samples_for_rejection)
+	{
+		auto mad = Mad();
+		if (mad > 0.0 && 0.6745 * std::fabs(rtt - WindowPercentile(50.0)) / mad > outlier_threshold)
+		{
+			accepted = false;
+		}
+	}
+
+	_window[_windowNext] = rtt;
+	_windowNext = (_windowNext + 1) % window_size;
+	_windowCount = std::min(_windowCount + 1, window_size);
+	_histogram[Bucket(rtt)]++;
+	_count++;
+	_min = std::min(_min, rtt);
+	_max = std::max(_max, rtt);
+
+	if (!accepted)
+	{
+		return false;
+	}
+
+	//Welford's running mean and variance...
+	_accepted++;
+	auto delta = rtt - _mean;
+	_mean += delta / _accepted;
+	_m2 += delta * (rtt - _mean);
+
+	if (_accepted > 1)
+	{
+		_jitterSum += std::fabs(rtt - _last);
+	}
+	_last = rtt;
+	return true;
+}
+
+size_t RttEstimator::Count() const
+{
+	return _count;
+}
+
+size_t RttEstimator::Accepted() const
+{
+	return _accepted;
+}
+
+size_t RttEstimator::Rejected() const
+{
+	return _count - _accepted;
+}
+
+double RttEstimator::Min() const
+{
+	return _count == 0 ? 0.0 : _min;
+}
+
+size_t RttEstimator::Sorted(std::array<double, window_size>& sorted) const
+{
+	std::copy(_window.begin(), _window.begin() + _windowCount, sorted.begin());
+	std::sort(sorted.begin(), sorted.begin() + _windowCount);
+	return _windowCount;
+}
+
+size_t RttEstimator::Bucket(double rtt)
+{
+	if (rtt < histogram_floor)
+	{
+		return 0;
+	}
+	auto bucket = static_cast<size_t>(std::log(rtt / histogram_floor) / std::log(histogram_growth)) + 1;
+	return std::min(bucket, histogram_buckets - 1);
+}
+
+double RttEstimator::Percentile(double percentile) const
+{
+	//while the window still holds every sample it gives the exact answer...
+	return _count <= window_size ? WindowPercentile(percentile) : HistogramPercentile(percentile);
+}
+
+double RttEstimator::HistogramPercentile(double percentile) const
+{
+	//the bucket holding the same rank the window would interpolate at, read at its geometric middle...
+	auto rank = std::min(std::max(percentile, 0.0), 100.0) / 100.0 * (_count - 1);
+	double seen = 0.0;
+	size_t bucket = 0;
+	for (; bucket < histogram_buckets - 1; ++bucket)
+	{
+		seen += _histogram[bucket];
+		if (seen > rank)
+		{
+			break;
+		}
+	}
+
+	auto value = bucket == 0 ? _min : histogram_floor * std::pow(histogram_growth, bucket - 0.5);
+	return std::min(std::max(value, _min), _max);
+}
+
+double RttEstimator::WindowPercentile(double percentile) const
+{
+	std::array<double, window_size> sorted;
+	auto n = Sorted(sorted);
+	if (n == 0)
+	{
+		return 0.0;
+	}
+
+	//linear interpolation between closest ranks...
+	auto rank = std::min(std::max(percentile, 0.0), 100.0) / 100.0 * (n - 1);
+	auto lower = static_cast<size_t>(rank);
+	auto upper = std::min(lower + 1, n - 1);
+	return sorted[lower] + (rank - lower) * (sorted[upper] - sorted[lower]);
+}
+
+double RttEstimator::Median() const
+{
+	return Percentile(50.0);
+}
+
+double RttEstimator::P90() const
+{
+	return Percentile(90.0);
+}
+
+double RttEstimator::P99() const
+{
+	return Percentile(99.0);
+}
+
+double RttEstimator::Mad() const
+{
+	if (_windowCount == 0)
+	{
+		return 0.0;
+	}
+
+	auto median = WindowPercentile(50.0);
+	std::array<double, window_size> deviations;
+	for (size_t i = 0; i < _windowCount; ++i)
+	{
+		deviations[i] = std::fabs(_window[i] - median);
+	}
+
+	auto middle = deviations.begin() + _windowCount / 2;
+	std::nth_element(deviations.begin(), middle, deviations.begin() + _windowCount);
+	if (_windowCount % 2 == 1)
+	{
+		return *middle;
+	}
+	return (*middle + *std::max_element(deviations.begin(), middle)) / 2.0;
+}
+
+double RttEstimator::Mean() const
+{
+	return _mean;
+}
+
+double RttEstimator::StdDev() const
+{
+	return _accepted > 1 ? std::sqrt(_m2 / (_accepted - 1)) : 0.0;
+}
+
+double RttEstimator::Jitter() const
+{
+	return _accepted > 1 ? _jitterSum / (_accepted - 1) : 0.0;
+}
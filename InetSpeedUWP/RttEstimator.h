@@ -0,0 +1,68 @@
+#pragma once
+#include "pch.h"
+
+#include <array>
+
+namespace InetSpeedUWP
+{
+	// Streaming round-trip time statistics in constant memory.
+	// Median and percentiles cover every sample: they are exact up to window_size samples, and past that come
+	// from a log-bucketed histogram whose buckets are histogram_growth (4%) apart, read at the middle of a
+	// bucket and never outside [min, max]. Mean, standard deviation and jitter are running values over accepted samples.
+	// Outlier rejection and Mad() use a ring buffer of the most recent window_size samples: a sample whose modified
+	// z-score against that window's median exceeds outlier_threshold is still counted everywhere else (so a real
+	// shift in latency is picked up) but does not touch the running values.
+	// All values are in seconds.
+	class RttEstimator
+	{
+	public:
+		static const size_t window_size = 64;
+		static const size_t min_samples_for_rejection = 5;
+		static const double outlier_threshold;
+		static const size_t histogram_buckets = 472;
+		static const double histogram_floor;
+		static const double histogram_growth;
+
+		RttEstimator();
+
+		// Returns false if the sample was rejected as an outlier.
+		bool Add(double rtt);
+		void Reset();
+
+		size_t Count() const;
+		size_t Accepted() const;
+		size_t Rejected() const;
+
+		double Min() const;
+		double Median() const;
+		double Percentile(double percentile) const;
+		double P90() const;
+		double P99() const;
+		double Mad() const;
+
+		double Mean() const;
+		double StdDev() const;
+		double Jitter() const;
+
+	private:
+		size_t Sorted(std::array<double, window_size>& sorted) const;
+		double WindowPercentile(double percentile) const;
+		double HistogramPercentile(double percentile) const;
+		static size_t Bucket(double rtt);
+
+		std::array<double, window_size> _window;
+		size_t _windowNext;
+		size_t _windowCount;
+
+		std::array<unsigned int, histogram_buckets> _histogram;
+
+		size_t _count;
+		size_t _accepted;
+		double _min;
+		double _max;
+		double _mean;
+		double _m2;
+		double _last;
+		double _jitterSum;
+	};
+}
@@ -0,0 +1,67 @@
+#include "pch.h"
+#include "SpeedBucketStopRule.h"
+#include "InternetConnectionState.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace InetSpeedUWP;
+
+namespace
+{
+	const double confidence_tail = 0.025;
+
+	//Largest k for which [X(k), X(n-k+1)] covers the median with 95% confidence, i.e. P(Binomial(n, 1/2) < k) <= 2.5%,
+	//or 0 when there are too few samples for any k...
+	size_t MedianIntervalRank(size_t samples)
+	{
+		auto probability = std::pow(0.5, static_cast<double>(samples));
+		auto cumulative = 0.0;
+		size_t rank = 0;
+		for (size_t i = 0; i < samples; ++i)
+		{
+			cumulative += probability;
+			if (cumulative > confidence_tail)
+			{
+				break;
+			}
+			rank = i + 1;
+			probability *= (samples - i) / (i + 1.0);
+		}
+		return rank;
+	}
+}
+
+SpeedBucketStopRule::SpeedBucketStopRule(size_t minSamples) :
+	_minSamples(std::max<size_t>(minSamples, 2))
+{
+}
+
+bool SpeedBucketStopRule::operator()(const std::vector<ProbeResult>& results) const
+{
+	std::vector<double> rtts;
+	for (const auto& result : results)
+	{
+		if (result.Succeeded)
+		{
+			rtts.push_back(result.Rtt);
+		}
+	}
+	return Decided(rtts, _minSamples);
+}
+
+bool SpeedBucketStopRule::Decided(std::vector<double> rtts, size_t minSamples)
+{
+	auto samples = rtts.size();
+	if (samples < std::max<size_t>(minSamples, 2))
+	{
+		return false;
+	}
+
+	std::sort(rtts.begin(), rtts.end());
+	auto rank = std::max<size_t>(MedianIntervalRank(samples), 1);
+	auto lower = std::max(rtts[rank - 1], std::numeric_limits<double>::min());
+	auto upper = rtts[samples - rank];
+	return InternetConnectionState::GetConnectionSpeed(lower) == InternetConnectionState::GetConnectionSpeed(upper);
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "pch.h"
+#include "ProbeEngine.h"
+
+#include <vector>
+
+namespace InetSpeedUWP
+{
+	// Sequential stop condition for ProbeEngine rounds.
+	// After at least minSamples successful probes, sampling stops as soon as the 95% confidence interval of
+	// the median RTT, the statistic the session classifies by, lies inside a single ConnectionSpeed bucket.
+	// The interval comes from order statistics, so it makes no assumption about the RTT distribution and an
+	// outlier cannot widen it; below 6 samples no such interval exists and the whole sample range must fit.
+	// Samples straddling the High/Average (1.4 ms) or Average/Low (140 ms) threshold keep the round going
+	// until the interval narrows or the round runs out of probes.
+	class SpeedBucketStopRule
+	{
+	public:
+		SpeedBucketStopRule(size_t minSamples);
+
+		bool operator()(const std::vector<ProbeResult>& results) const;
+
+		static bool Decided(std::vector<double> rtts, size_t minSamples);
+
+	private:
+		size_t _minSamples;
+	};
+}
@@ -0,0 +1,168 @@
+#include "pch.h"
+#include "SpeedCache.h"
+#include "NetworkChangeMonitor.h"
+
+using namespace InetSpeedUWP;
+using namespace Concurrency;
+using namespace Platform;
+
+const long long default_cache_ttl_ms = 15000;
+const long long default_cache_stale_ms = 45000;
+
+SpeedCache& SpeedCache::Instance()
+{
+	static SpeedCache* cache = new SpeedCache();
+	return *cache;
+}
+
+SpeedCache::SpeedCache() :
+	_generation(0),
+	_timeToLive(default_cache_ttl_ms),
+	_staleWindow(default_cache_stale_ms)
+{
+	NetworkChangeMonitor::Instance().Subscribe([this]
+	{
+		Invalidate();
+	});
+}
+
+void SpeedCache::Invalidate()
+{
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	_entries.clear();
+	_generation++;
+}
+
+task<SpeedMeasurement> SpeedCache::Get(String^ target, Probe probe)
+{
+	std::wstring key(target == nullptr ? L"" : target->Data());
+	auto now = clock_type::now();
+
+	task_completion_event<SpeedMeasurement> completion;
+	unsigned long long generation;
+	bool start = false;
+	task<SpeedMeasurement> result;
+	{
+		std::lock_guard<std::mutex> scopedLock(_lock);
+		auto& entry = _entries[key];
+		bool stale = false;
+		if (entry.Valid)
+		{
+			auto age = now - entry.Measured;
+			if (age < _timeToLive)
+			{
+				return task_from_result(entry.Value);
+			}
+
+			//serve the stale value now, refresh behind the caller's back...
+			stale = age < _timeToLive + _staleWindow;
+		}
+
+		if (!entry.Probing)
+		{
+			BeginProbe(entry, completion);
+			start = true;
+		}
+		generation = _generation;
+		result = stale ? task_from_result(entry.Value) : entry.InFlight;
+	}
+
+	//connects start outside the lock, the entry already tells other callers a probe is on its way...
+	if (start)
+	{
+		RunProbe(key, generation, probe, completion);
+	}
+	return result;
+}
+
+//Caller must hold _lock...
+void SpeedCache::BeginProbe(Entry& entry, task_completion_event<SpeedMeasurement> completion)
+{
+	entry.Probing = true;
+	entry.InFlight = create_task(completion);
+
+	//a background refresh may have no waiter at all, its failure must not go unobserved...
+	entry.InFlight.then([](task<SpeedMeasurement> probed)
+	{
+		try
+		{
+			probed.get();
+		}
+		catch (...)
+		{
+		}
+	});
+}
+
+void SpeedCache::RunProbe(const std::wstring& key, unsigned long long generation, Probe probe, task_completion_event<SpeedMeasurement> completion)
+{
+	task<SpeedMeasurement> probing;
+	try
+	{
+		probing = probe();
+	}
+	catch (...)
+	{
+		probing = task_from_exception<SpeedMeasurement>(std::current_exception());
+	}
+
+	probing.then([this, key, generation, completion](task<SpeedMeasurement> probed)
+	{
+		try
+		{
+			auto measurement = probed.get();
+			{
+				std::lock_guard<std::mutex> scopedLock(_lock);
+				auto found = _entries.find(key);
+				//a result taken on a network that has since changed is handed to its waiters but not kept...
+				if (generation == _generation && found != _entries.end())
+				{
+					found->second.Probing = false;
+					if (measurement.Speed != ConnectionSpeed::Unknown)
+					{
+						found->second.Valid = true;
+						found->second.Value = measurement;
+						found->second.Measured = clock_type::now();
+					}
+				}
+			}
+			completion.set(measurement);
+		}
+		catch (...)
+		{
+			{
+				std::lock_guard<std::mutex> scopedLock(_lock);
+				auto found = _entries.find(key);
+				if (generation == _generation && found != _entries.end())
+				{
+					found->second.Probing = false;
+				}
+			}
+			completion.set_exception(std::current_exception());
+		}
+	});
+}
+
+std::chrono::milliseconds SpeedCache::TimeToLive()
+{
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	return _timeToLive;
+}
+
+void SpeedCache::SetTimeToLive(std::chrono::milliseconds timeToLive)
+{
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	_timeToLive = timeToLive;
+}
+
+std::chrono::milliseconds SpeedCache::StaleWindow()
+{
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	return _staleWindow;
+}
+
+void SpeedCache::SetStaleWindow(std::chrono::milliseconds staleWindow)
+{
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	_staleWindow = staleWindow;
+}
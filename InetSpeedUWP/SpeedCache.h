@@ -0,0 +1,67 @@
+#pragma once
+#include "pch.h"
+#include "Enums.h"
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace InetSpeedUWP
+{
+	// Result of one latency measurement.
+	struct SpeedMeasurement
+	{
+		ConnectionSpeed Speed;
+		double RawSpeed;
+	};
+
+	// Per-target cache of latency measurements.
+	// A result younger than the time-to-live is returned as is. Once it is older than that, but still within the
+	// stale window, it is returned immediately and a refresh probe starts in the background (stale-while-revalidate).
+	// Past that, callers wait for a new probe, and concurrent callers for the same target share it.
+	// Everything is dropped when NetworkChangeMonitor reports a new network. Unknown results are not cached.
+	class SpeedCache
+	{
+	public:
+		typedef std::function<concurrency::task<SpeedMeasurement>()> Probe;
+
+		static SpeedCache& Instance();
+
+		concurrency::task<SpeedMeasurement> Get(Platform::String^ target, Probe probe);
+		void Invalidate();
+
+		std::chrono::milliseconds TimeToLive();
+		void SetTimeToLive(std::chrono::milliseconds timeToLive);
+		std::chrono::milliseconds StaleWindow();
+		void SetStaleWindow(std::chrono::milliseconds staleWindow);
+
+	private:
+		typedef std::chrono::steady_clock clock_type;
+
+		struct Entry
+		{
+			Entry() : Valid(false), Probing(false) {}
+
+			bool Valid;
+			SpeedMeasurement Value;
+			clock_type::time_point Measured;
+			bool Probing;
+			concurrency::task<SpeedMeasurement> InFlight;
+		};
+
+		SpeedCache();
+		SpeedCache(const SpeedCache&) = delete;
+		SpeedCache& operator=(const SpeedCache&) = delete;
+
+		void BeginProbe(Entry& entry, concurrency::task_completion_event<SpeedMeasurement> completion);
+		void RunProbe(const std::wstring& key, unsigned long long generation, Probe probe, concurrency::task_completion_event<SpeedMeasurement> completion);
+
+		std::mutex _lock;
+		std::map<std::wstring, Entry> _entries;
+		unsigned long long _generation;
+		std::chrono::milliseconds _timeToLive;
+		std::chrono::milliseconds _staleWindow;
+	};
+}
@@ -0,0 +1,171 @@
+#include "pch.h"
+#include "ThroughputMeter.h"
+#include "ReflectorProtocol.h"
+#include "pplpp.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace InetSpeedUWP;
+using namespace Concurrency;
+using namespace Platform;
+using namespace Windows::Networking;
+using namespace Windows::Networking::Sockets;
+using namespace Windows::Storage::Streams;
+using namespace pplpp;
+
+namespace
+{
+	using ReflectorProtocol::clock_type;
+
+	// Byte accounting shared by all streams of one measurement.
+	class TransferCounter
+	{
+	public:
+		TransferCounter(std::chrono::milliseconds duration, std::chrono::milliseconds warmup) :
+			_warmupEnd(clock_type::now() + warmup),
+			_deadline(clock_type::now() + duration),
+			_total(0),
+			_warmupBytes(0),
+			_warmedUp(false)
+		{
+		}
+
+		bool Expired() const
+		{
+			return clock_type::now() >= _deadline;
+		}
+
+		//started is when the transfer was issued; the first one to complete after the warm-up opens the measured
+		//window at its start, so the time its bytes took is part of the window too...
+		void Record(unsigned int bytes, clock_type::time_point started)
+		{
+			auto now = clock_type::now();
+			std::lock_guard<std::mutex> scopedLock(_lock);
+			if (!_warmedUp && now >= _warmupEnd)
+			{
+				_warmedUp = true;
+				_warmupBytes = _total;
+				_warmupTime = started;
+			}
+			_total += bytes;
+			_lastTime = now;
+		}
+
+		double BitsPerSecond()
+		{
+			std::lock_guard<std::mutex> scopedLock(_lock);
+			if (!_warmedUp)
+			{
+				return 0.0;
+			}
+
+			auto elapsed = std::chrono::duration<double>(_lastTime - _warmupTime).count();
+			return elapsed > 0.0 ? (_total - _warmupBytes) * 8.0 / elapsed : 0.0;
+		}
+
+	private:
+		std::mutex _lock;
+		clock_type::time_point _warmupEnd;
+		clock_type::time_point _deadline;
+		clock_type::time_point _warmupTime;
+		clock_type::time_point _lastTime;
+		unsigned long long _total;
+		unsigned long long _warmupBytes;
+		bool _warmedUp;
+	};
+
+	task<void> RunStream(std::shared_ptr<TransferCounter> counter, HostName^ hostName, String^ serviceName, TransferDirection direction, cancellation_token token)
+	{
+		StreamSocket^ clientSocket;
+		task<void> connect;
+		try
+		{
+			clientSocket = ref new StreamSocket();
+			connect = create_task(clientSocket->ConnectAsync(hostName, serviceName, SocketProtectionLevel::PlainSocket), token);
+		}
+		catch (Platform::COMException^ e) //e.g. an invalid service name, fault the stream rather than the caller...
+		{
+			return task_from_exception<void>(e);
+		}
+
+		return connect.then([clientSocket, direction, token]
+		{
+			auto writer = ref new DataWriter(clientSocket->OutputStream);
+			writer->WriteByte(direction == TransferDirection::Download ? ReflectorProtocol::SourceCommand : ReflectorProtocol::DiscardCommand);
+			return create_task(writer->StoreAsync(), token).then([writer](unsigned int)
+			{
+				writer->DetachStream();
+			});
+		}).then([counter, clientSocket, direction, token]
+		{
+			auto buffer = ref new Buffer(ReflectorProtocol::ChunkSize);
+			if (direction == TransferDirection::Download)
+			{
+				return create_iterative_task([counter, clientSocket, buffer, token]
+				{
+					auto started = clock_type::now();
+					return create_task(clientSocket->InputStream->ReadAsync(buffer, ReflectorProtocol::ChunkSize, InputStreamOptions::Partial), token).then([counter, started](IBuffer^ read)
+					{
+						counter->Record(read->Length, started);
+						return read->Length > 0 && !counter->Expired();
+					});
+				});
+			}
+
+			buffer->Length = ReflectorProtocol::ChunkSize;
+			return create_iterative_task([counter, clientSocket, buffer, token]
+			{
+				auto started = clock_type::now();
+				return create_task(clientSocket->OutputStream->WriteAsync(buffer), token).then([counter, started](unsigned int written)
+				{
+					counter->Record(written, started);
+					return written > 0 && !counter->Expired();
+				});
+			});
+		}).then([clientSocket](task<void> stream)
+		{
+			try
+			{
+				stream.get();
+			}
+			catch (Platform::COMException^) //a stream that fails just stops contributing...
+			{
+			}
+			catch (task_canceled&) //the deadline cut a pending transfer short, which is how a stalled stream ends...
+			{
+			}
+			delete clientSocket;
+		});
+	}
+}
+
+ThroughputMeter::ThroughputMeter(unsigned int streams, std::chrono::milliseconds duration, std::chrono::milliseconds warmup) :
+	_streams(std::max(streams, 1u)),
+	_duration(duration),
+	_warmup(std::min(warmup, duration))
+{
+}
+
+task<double> ThroughputMeter::Measure(HostName^ hostName, String^ serviceName, TransferDirection direction) const
+{
+	auto counter = std::make_shared<TransferCounter>(_duration, _warmup);
+
+	//a silent or stalled peer leaves a transfer pending, the deadline must cancel it rather than wait for it...
+	timed_cancellation_token_source deadline;
+	auto pending = deadline.cancel(_duration);
+
+	std::vector<task<void>> streams;
+	for (unsigned int i = 0; i < _streams; ++i)
+	{
+		streams.push_back(RunStream(counter, hostName, serviceName, direction, deadline.get_token()));
+	}
+
+	return concurrency::when_all(streams.begin(), streams.end()).then([counter, pending]
+	{
+		pending.disarm();
+		return counter->BitsPerSecond();
+	});
+}
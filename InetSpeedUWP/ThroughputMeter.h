@@ -0,0 +1,28 @@
+#pragma once
+#include "pch.h"
+#include "Enums.h"
+
+#include <chrono>
+
+namespace InetSpeedUWP
+{
+	// Bulk-transfer throughput measurement against a ReflectorServer.
+	// Several TCP streams run in parallel for the given duration; whatever moves during the warm-up window
+	// (slow start, connection setup) is discarded, and the result is the aggregate rate from the end of the
+	// warm-up window to the last completed transfer, in bits per second. Zero means nothing got through.
+	// Transfers still pending when the duration is up are cancelled, so a stalled peer cannot hold the result.
+	class ThroughputMeter
+	{
+	public:
+		ThroughputMeter(unsigned int streams, std::chrono::milliseconds duration, std::chrono::milliseconds warmup);
+
+		concurrency::task<double> Measure(Windows::Networking::HostName^ hostName, Platform::String^ serviceName, TransferDirection direction) const;
+
+		std::chrono::milliseconds Duration() const { return _duration; }
+
+	private:
+		unsigned int _streams;
+		std::chrono::milliseconds _duration;
+		std::chrono::milliseconds _warmup;
+	};
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "pch.h"
+
+namespace InetSpeedUWP
+{
+	// Sustained throughput measured by InternetConnectionState::GetInternetThroughputAsync, in bits per second.
+	// A direction that could not be measured reports 0.
+	public ref class ThroughputResult sealed
+	{
+	public:
+		property double DownloadBitsPerSecond { double get() { return _download; } }
+		property double UploadBitsPerSecond { double get() { return _upload; } }
+
+	internal:
+		ThroughputResult(double download, double upload) : _download(download), _upload(upload) {}
+
+	private:
+		double _download;
+		double _upload;
+	};
+}
@@ -0,0 +1,87 @@
+#include "pch.h"
+#include "TimeoutPolicy.h"
+#include "NetworkChangeMonitor.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace InetSpeedUWP;
+using namespace Platform;
+
+//RFC 6298 gains and clock granularity...
+const double srtt_gain = 0.125;
+const double rttvar_gain = 0.25;
+const double rttvar_multiplier = 4.0;
+const double clock_granularity = 0.001;
+const unsigned int max_backoff = 64;
+
+TimeoutPolicy& TimeoutPolicy::Instance()
+{
+	static TimeoutPolicy* policy = new TimeoutPolicy();
+	return *policy;
+}
+
+TimeoutPolicy::TimeoutPolicy()
+{
+	//RTT history of one network says nothing about the next...
+	NetworkChangeMonitor::Instance().Subscribe([this]
+	{
+		Invalidate();
+	});
+}
+
+void TimeoutPolicy::Invalidate()
+{
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	_history.clear();
+}
+
+std::chrono::milliseconds TimeoutPolicy::Timeout(String^ target, TimeoutBounds bounds)
+{
+	std::wstring key(target == nullptr ? L"" : target->Data());
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	auto found = _history.find(key);
+	if (found == _history.end() || found->second.Srtt == 0.0)
+	{
+		return bounds.Max;
+	}
+
+	auto& history = found->second;
+	auto rto = (history.Srtt + std::max(clock_granularity, rttvar_multiplier * history.RttVar)) * history.Backoff;
+	auto timeout = std::chrono::milliseconds(static_cast<long long>(std::ceil(rto * 1000.0)));
+	return std::min(std::max(timeout, bounds.Min), bounds.Max);
+}
+
+void TimeoutPolicy::OnSample(String^ target, double rtt)
+{
+	if (!(rtt > 0.0))
+	{
+		return;
+	}
+
+	std::wstring key(target == nullptr ? L"" : target->Data());
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	auto& history = _history[key];
+	if (history.Srtt == 0.0)
+	{
+		history.Srtt = rtt;
+		history.RttVar = rtt / 2.0;
+	}
+	else
+	{
+		history.RttVar = (1.0 - rttvar_gain) * history.RttVar + rttvar_gain * std::abs(history.Srtt - rtt);
+		history.Srtt = (1.0 - srtt_gain) * history.Srtt + srtt_gain * rtt;
+	}
+	history.Backoff = 1;
+}
+
+void TimeoutPolicy::OnTimeout(String^ target)
+{
+	std::wstring key(target == nullptr ? L"" : target->Data());
+	std::lock_guard<std::mutex> scopedLock(_lock);
+	auto found = _history.find(key);
+	if (found != _history.end())
+	{
+		found->second.Backoff = std::min(found->second.Backoff * 2, max_backoff);
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "pch.h"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace InetSpeedUWP
+{
+	// Range a connect timeout may take; Max is also what a target without history gets.
+	struct TimeoutBounds
+	{
+		std::chrono::milliseconds Min;
+		std::chrono::milliseconds Max;
+	};
+
+	// Process-wide, per-target connect timeouts derived from RTT history the way TCP derives its retransmission
+	// timeout (RFC 6298): a smoothed RTT and RTT variance are kept per target, the timeout is SRTT + 4 * RTTVAR,
+	// doubled for every consecutive timeout, and clamped to the caller's bounds. History is dropped when
+	// NetworkChangeMonitor reports a new network.
+	class TimeoutPolicy
+	{
+	public:
+		static TimeoutPolicy& Instance();
+
+		std::chrono::milliseconds Timeout(Platform::String^ target, TimeoutBounds bounds);
+		void OnSample(Platform::String^ target, double rtt);
+		void OnTimeout(Platform::String^ target);
+		void Invalidate();
+
+	private:
+		struct History
+		{
+			History() : Srtt(0.0), RttVar(0.0), Backoff(1) {}
+
+			double Srtt;
+			double RttVar;
+			unsigned int Backoff;
+		};
+
+		TimeoutPolicy();
+		TimeoutPolicy(const TimeoutPolicy&) = delete;
+		TimeoutPolicy& operator=(const TimeoutPolicy&) = delete;
+
+		std::mutex _lock;
+		std::map<std::wstring, History> _history;
+	};
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "pch.h"
+#include "UdpProber.h"
+
+namespace InetSpeedUWP
+{
+	// Result of InternetConnectionState::GetUdpProbeAsync. Latencies are round-trip times in seconds with the time
+	// spent in the reflector removed (0 if no probe came back); percentiles cover every reply.
+	// ForwardJitter and ReverseJitter are the one-way jitter towards and back from the reflector.
+	public ref class UdpProbeResult sealed
+	{
+	public:
+		property double LossRate { double get() { return _stats.Sent > 0 ? 1.0 - static_cast<double>(_stats.Received) / _stats.Sent : 0.0; } }
+		property double Median { double get() { return _stats.Rtt.Median(); } }
+		property double P90 { double get() { return _stats.Rtt.P90(); } }
+		property double P99 { double get() { return _stats.Rtt.P99(); } }
+		property double Jitter { double get() { return _stats.Rtt.Jitter(); } }
+		property double ForwardJitter { double get() { return _stats.ForwardJitter; } }
+		property double ReverseJitter { double get() { return _stats.ReverseJitter; } }
+		property int SentCount { int get() { return static_cast<int>(_stats.Sent); } }
+		property int ReceivedCount { int get() { return static_cast<int>(_stats.Received); } }
+		property int ReorderedCount { int get() { return static_cast<int>(_stats.Reordered); } }
+		property int DuplicateCount { int get() { return static_cast<int>(_stats.Duplicates); } }
+
+	internal:
+		UdpProbeResult(const UdpProbeStats& stats) : _stats(stats) {}
+
+	private:
+		UdpProbeStats _stats;
+	};
+}
@@ -0,0 +1,193 @@
+#include "pch.h"
+#include "UdpProber.h"
+#include "ReflectorProtocol.h"
+#include "pplpp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace InetSpeedUWP;
+using namespace Concurrency;
+using namespace Platform;
+using namespace Windows::Foundation;
+using namespace Windows::Networking;
+using namespace Windows::Networking::Sockets;
+using namespace Windows::Storage::Streams;
+using namespace pplpp;
+
+namespace
+{
+	using ReflectorProtocol::clock_type;
+	using ReflectorProtocol::Timestamp;
+
+	// The four timestamps of one reflected probe, in nanoseconds: Sent and Arrived on our clock,
+	// Received and Reflected on the reflector's.
+	struct ProbeTimes
+	{
+		unsigned long long Sent;
+		unsigned long long Received;
+		unsigned long long Reflected;
+		unsigned long long Arrived;
+	};
+
+	// Shared state of one Run() call; the receive handler and the send loop both hold a reference to it.
+	struct ProbeBurst
+	{
+		std::mutex Lock;
+		std::vector<bool> Seen;
+		unsigned long long Highest;
+		bool HaveLast;
+		ProbeTimes Last;
+		UdpProbeStats Stats;
+	};
+
+	double Seconds(long long nanoseconds)
+	{
+		return nanoseconds / 1e9;
+	}
+
+	//RFC 3550: J += (|D| - J) / 16, D being how much the transit time changed between consecutive packets...
+	void UpdateJitter(double& jitter, long long transitChange)
+	{
+		jitter += (std::fabs(Seconds(transitChange)) - jitter) / 16.0;
+	}
+
+	void OnReply(ProbeBurst& burst, DatagramSocketMessageReceivedEventArgs^ args)
+	{
+		auto arrived = Timestamp();
+		auto reader = args->GetDataReader();
+		if (reader->UnconsumedBufferLength < ReflectorProtocol::UdpProbeSize)
+		{
+			return;
+		}
+
+		auto sequence = reader->ReadUInt64();
+		ProbeTimes times;
+		times.Sent = reader->ReadUInt64();
+		times.Received = reader->ReadUInt64();
+		times.Reflected = reader->ReadUInt64();
+		times.Arrived = arrived;
+
+		std::lock_guard<std::mutex> scopedLock(burst.Lock);
+		if (sequence >= burst.Seen.size())
+		{
+			return;
+		}
+		if (burst.Seen[static_cast<size_t>(sequence)])
+		{
+			burst.Stats.Duplicates++;
+			return;
+		}
+		burst.Seen[static_cast<size_t>(sequence)] = true;
+		burst.Stats.Received++;
+
+		//the time the reflector spent turning the probe around is not part of the path...
+		auto rtt = static_cast<long long>(times.Arrived - times.Sent) - static_cast<long long>(times.Reflected - times.Received);
+		burst.Stats.Rtt.Add(Seconds(std::max(rtt, 0LL)));
+
+		if (burst.HaveLast)
+		{
+			if (sequence < burst.Highest)
+			{
+				burst.Stats.Reordered++;
+			}
+			UpdateJitter(burst.Stats.ForwardJitter, static_cast<long long>(times.Received - burst.Last.Received) - static_cast<long long>(times.Sent - burst.Last.Sent));
+			UpdateJitter(burst.Stats.ReverseJitter, static_cast<long long>(times.Arrived - burst.Last.Arrived) - static_cast<long long>(times.Reflected - burst.Last.Reflected));
+		}
+		burst.Highest = std::max(burst.Highest, sequence);
+		burst.Last = times;
+		burst.HaveLast = true;
+	}
+}
+
+UdpProber::UdpProber(size_t count, std::chrono::milliseconds interval, std::chrono::milliseconds linger) :
+	_count(count),
+	_interval(interval),
+	_linger(linger)
+{
+}
+
+task<UdpProbeStats> UdpProber::Run(HostName^ hostName, String^ serviceName) const
+{
+	auto burst = std::make_shared<ProbeBurst>();
+	burst->Seen.assign(_count, false);
+	burst->Highest = 0;
+	burst->HaveLast = false;
+	burst->Stats.Sent = 0;
+	burst->Stats.Received = 0;
+	burst->Stats.Reordered = 0;
+	burst->Stats.Duplicates = 0;
+	burst->Stats.ForwardJitter = 0.0;
+	burst->Stats.ReverseJitter = 0.0;
+
+	if (_count == 0)
+	{
+		return task_from_result(burst->Stats);
+	}
+
+	auto socket = ref new DatagramSocket();
+	socket->MessageReceived += ref new TypedEventHandler<DatagramSocket^, DatagramSocketMessageReceivedEventArgs^>(
+		[burst](DatagramSocket^, DatagramSocketMessageReceivedEventArgs^ args)
+	{
+		try
+		{
+			OnReply(*burst, args);
+		}
+		catch (Platform::COMException^) //ICMP unreachable surfaces here as a failed read, the probe is simply lost...
+		{
+		}
+	});
+
+	auto count = _count;
+	auto interval = _interval;
+	auto linger = _linger;
+	return create_task(socket->ConnectAsync(hostName, serviceName)).then([socket, burst, count, interval]
+	{
+		auto writer = ref new DataWriter(socket->OutputStream);
+		auto start = clock_type::now();
+		auto next = std::make_shared<unsigned long long>(0);
+		return create_iterative_task([writer, burst, count, interval, start, next]
+		{
+			auto sequence = (*next)++;
+			writer->WriteUInt64(sequence);
+			writer->WriteUInt64(Timestamp());
+			writer->WriteUInt64(0);
+			writer->WriteUInt64(0);
+			return create_task(writer->StoreAsync()).then([burst, count, interval, start, sequence](unsigned int)
+			{
+				{
+					std::lock_guard<std::mutex> scopedLock(burst->Lock);
+					burst->Stats.Sent++;
+				}
+				if (sequence + 1 >= count)
+				{
+					return task_from_result(false);
+				}
+
+				//keep to the schedule rather than waiting a full interval after each send...
+				auto due = start + interval * static_cast<long long>(sequence + 1);
+				auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(due - clock_type::now());
+				auto more = [] { return true; };
+				return wait.count() > 0 ? create_timer_task(wait).then(more) : task_from_result(true);
+			});
+		});
+	}).then([linger](task<void> sending)
+	{
+		try
+		{
+			sending.get();
+		}
+		catch (Platform::COMException^) //unresolvable host or a failed send, report whatever went out...
+		{
+		}
+		return create_timer_task(linger);
+	}).then([socket, burst]
+	{
+		delete socket;
+		std::lock_guard<std::mutex> scopedLock(burst->Lock);
+		return burst->Stats;
+	});
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "pch.h"
+#include "RttEstimator.h"
+
+#include <chrono>
+
+namespace InetSpeedUWP
+{
+	// Outcome of UdpProber::Run. Rtt holds the round-trip times of the probes that came back, with the time spent
+	// inside the reflector taken out. ForwardJitter and ReverseJitter are the RFC 3550 interarrival jitter of each
+	// direction in seconds; they only compare timestamps taken on the same side, so the two clocks need not agree.
+	struct UdpProbeStats
+	{
+		size_t Sent;
+		size_t Received;
+		size_t Reordered;
+		size_t Duplicates;
+		RttEstimator Rtt;
+		double ForwardJitter;
+		double ReverseJitter;
+	};
+
+	// Sends a short, paced burst of timestamped UDP probes (TWAMP-light style, see ReflectorProtocol.h) to a
+	// ReflectorServer and collects the reflected ones. Probes go out every interval on a fixed schedule; replies
+	// still missing linger after the last one was sent are counted as lost. A reply with a lower sequence number
+	// than one already received counts as reordered.
+	class UdpProber
+	{
+	public:
+		UdpProber(size_t count, std::chrono::milliseconds interval, std::chrono::milliseconds linger);
+
+		concurrency::task<UdpProbeStats> Run(Windows::Networking::HostName^ hostName, Platform::String^ serviceName) const;
+
+	private:
+		size_t _count;
+		std::chrono::milliseconds _interval;
+		std::chrono::milliseconds _linger;
+	};
+}
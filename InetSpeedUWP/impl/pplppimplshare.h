@@ -39,28 +39,79 @@ namespace pplpp
 {
     namespace details
     {
-        static void iterative_task_impl(concurrency::task_completion_event<void> finished, std::function<concurrency::task<bool>()> body, 
-            concurrency::cancellation_token ct, concurrency::cancellation_token_source cts, concurrency::task_continuation_context context = concurrency::task_continuation_context::use_default())
+        /// <summary>
+        ///     State shared by every iteration of one <c>create_iterative_task</c> loop. It is allocated once, and
+        ///     each continuation only captures a pointer to it instead of copying the body and tokens again.
+        /// </summary>
+        struct iterative_task_state
         {
-            if (ct.is_canceled())
+            std::function<concurrency::task<bool>()> body;
+            concurrency::task_completion_event<void> finished;
+            concurrency::cancellation_token ct;
+            concurrency::cancellation_token_source cts;
+            concurrency::task_continuation_context context;
+
+            iterative_task_state(std::function<concurrency::task<bool>()> body, concurrency::cancellation_token ct, concurrency::task_continuation_context context) :
+                body(std::move(body)), ct(ct), context(context)
             {
-                cts.cancel();
-                return;
             }
-            body().then([=](concurrency::task<bool> previous) {
-                try {
-                    if (previous.get())
-                        iterative_task_impl(finished, body, ct, cts, context);
-                    else
-                        finished.set();
+        };
+
+        // Iterations whose task has already completed run back to back on the current thread, up to this many,
+        // before the loop goes through a continuation again; the loop never recurses, so the stack stays flat.
+        static const unsigned int max_inline_iterations = 64;
+
+        // Returns true if the loop should run another iteration.
+        static bool iterative_task_step(const std::shared_ptr<iterative_task_state>& state, concurrency::task<bool> previous)
+        {
+            try {
+                if (previous.get())
+                    return true;
+                state->finished.set();
+            }
+            catch (concurrency::task_canceled) {
+                state->cts.cancel();
+            }
+            catch (...) {
+                state->finished.set_exception(std::current_exception());
+            }
+            return false;
+        }
+
+        static void iterative_task_impl(const std::shared_ptr<iterative_task_state>& state)
+        {
+            for (unsigned int inlined = 0; ; ++inlined)
+            {
+                if (state->ct.is_canceled())
+                {
+                    state->cts.cancel();
+                    return;
                 }
-                catch (concurrency::task_canceled) {
-                    cts.cancel();
+
+                concurrency::task<bool> next;
+                try {
+                    next = state->body();
                 }
                 catch (...) {
-                    finished.set_exception(std::current_exception());
+                    state->finished.set_exception(std::current_exception());
+                    return;
+                }
+
+                if (!next.is_done() || inlined == max_inline_iterations)
+                {
+                    // Cancellation is checked at the top of the loop rather than by the continuation, so a canceled
+                    // token always cancels the returned task instead of leaving it waiting on a skipped continuation.
+                    auto pinned = state;
+                    next.then([pinned](concurrency::task<bool> previous) {
+                        if (iterative_task_step(pinned, previous))
+                            iterative_task_impl(pinned);
+                    }, state->context);
+                    return;
                 }
-            }, ct, context);
+
+                if (!iterative_task_step(state, next))
+                    return;
+            }
         }
     } // namespace details
 
@@ -100,6 +151,36 @@ namespace pplpp
         return concurrency::create_task(tce, ct);
     }
         
+    /// <summary>
+    ///     Handle to a delayed cancelation queued by <c>timed_cancellation_token_source::cancel(delay)</c>.
+    ///     Disarming it as soon as the guarded work finishes releases the underlying timer right away
+    ///     instead of leaving it queued for the rest of the delay.
+    /// </summary>
+    class delayed_cancellation
+    {
+        details::timer_handle m_handle;
+        bool m_armed;
+    public:
+        delayed_cancellation() : m_handle(), m_armed(false)
+        {
+        }
+
+        explicit delayed_cancellation(details::timer_handle handle) : m_handle(handle), m_armed(true)
+        {
+        }
+
+        /// <summary>
+        ///     Disarms the pending cancelation. The associated <c>cancellation_token_source</c> is left untouched.
+        /// </summary>
+        /// <returns>
+        ///     <c>true</c> if the cancelation was still pending, <c>false</c> if it already happened or was disarmed.
+        /// </returns>
+        bool disarm() const
+        {
+            return m_armed && timer_pool_t().cancel_timer(m_handle);
+        }
+    };
+
     /// <summary>
     ///     <c>cancellation_token_source</c> with delayed cancelation feature. <c>cancel</c> method
     ///     in this class has a overload that will cancel this <c>cancellation_token_source</c> after a delay.
@@ -125,12 +206,15 @@ namespace pplpp
         /// <param name="delay">
         ///     The delay time for the cancelation action.
         /// </param>
-        void cancel(std::chrono::milliseconds delay)
+        /// <returns>
+        ///     A <c>delayed_cancellation</c> that can disarm the pending cancelation once the guarded work is done.
+        /// </returns>
+        delayed_cancellation cancel(std::chrono::milliseconds delay)
         {
             auto tokenSource = m_tokenSource; // add a ref-count
-            timer_pool_t().queue_timer_callback(delay, [tokenSource] (bool) {
+            return delayed_cancellation(timer_pool_t().queue_timer_callback(delay, [tokenSource] (bool) {
                 tokenSource.cancel();
-            });
+            }));
         }
   
         /// <summary>
@@ -166,19 +250,14 @@ namespace pplpp
     /// <remarks>
     ///     This function dynamically creates a long chain of continuations by iteratively concating tasks created by user Functor <paramref name="body"/>,
     ///     The iteration will not stop until the result of the returning task from user Functor <paramref name="body"/> is <c> False </c>.
+    ///     Iterations that complete synchronously run inline (a bounded number at a time) instead of through a new continuation.
     /// </remarks>
     inline concurrency::task<void> create_iterative_task(std::function<concurrency::task<bool>()> body, 
         concurrency::task_continuation_context context = concurrency::task_continuation_context::use_default(), concurrency::cancellation_token ct = concurrency::cancellation_token::none())
     {
-        concurrency::task_completion_event<void> finished;
-        concurrency::cancellation_token_source cts;
-        auto runnable = [=] {
-            try {
-                details::iterative_task_impl(finished, body, ct, cts, context);
-            }
-            catch (...) {
-                finished.set_exception(std::current_exception());
-            }
+        auto state = std::make_shared<details::iterative_task_state>(std::move(body), ct, context);
+        auto runnable = [state] {
+            details::iterative_task_impl(state);
         };
 #ifdef __cplusplus_winrt
         if (context == concurrency::task_continuation_context::use_current())
@@ -187,10 +266,171 @@ namespace pplpp
 #endif
             concurrency::create_task(runnable);
 
-        return concurrency::create_task(finished, cts.get_token());
+        return concurrency::create_task(state->finished, state->cts.get_token());
     }
 
 
+    /// <summary>
+    ///     How progress reports are delivered to one subscriber of <c>task_with_progress::on_progress</c>.
+    ///     Coalescing lets a producer report per packet while the subscriber (and the marshaling to its
+    ///     apartment) only sees as many calls as it can use.
+    /// </summary>
+    template <typename ProgressType>
+    class progress_coalescing
+    {
+    public:
+        typedef std::function<ProgressType (ProgressType, ProgressType)> combine_function;
+
+        /// <summary>
+        ///     Every report is delivered as it happens. This is the default.
+        /// </summary>
+        static progress_coalescing every()
+        {
+            return progress_coalescing(false, std::chrono::milliseconds::zero(), combine_function());
+        }
+
+        /// <summary>
+        ///     Latest value wins: reports made while a delivery is still running replace each other,
+        ///     and only the newest one is delivered when it finishes.
+        /// </summary>
+        static progress_coalescing latest()
+        {
+            return progress_coalescing(true, std::chrono::milliseconds::zero(), combine_function());
+        }
+
+        /// <summary>
+        ///     Latest value wins, delivered at most <paramref name="hz"/> times per second.
+        ///     The last report is always delivered, at most one period late.
+        /// </summary>
+        static progress_coalescing max_rate(double hz)
+        {
+            auto period = hz > 0 ? std::chrono::milliseconds(static_cast<long long>(1000.0 / hz)) : std::chrono::milliseconds::zero();
+            return progress_coalescing(true, period, combine_function());
+        }
+
+        /// <summary>
+        ///     Reports are folded together with <paramref name="combine"/> (e.g. summing byte counts)
+        ///     and the aggregate is flushed at most once every <paramref name="interval"/>.
+        /// </summary>
+        static progress_coalescing aggregate(combine_function combine, std::chrono::milliseconds interval)
+        {
+            return progress_coalescing(true, interval, combine);
+        }
+
+        bool enabled() const { return m_enabled; }
+        std::chrono::milliseconds interval() const { return m_interval; }
+        const combine_function& combine() const { return m_combine; }
+
+    private:
+        progress_coalescing(bool enabled, std::chrono::milliseconds interval, combine_function combine) :
+            m_enabled(enabled), m_interval(interval), m_combine(combine)
+        {
+        }
+
+        bool m_enabled;
+        std::chrono::milliseconds m_interval;
+        combine_function m_combine;
+    };
+
+    namespace details
+    {
+        /// <summary>
+        ///     Per-subscriber coalescing state. At most one delivery is in flight or scheduled at any time;
+        ///     reports arriving meanwhile are folded into a single pending value, which whoever finishes the
+        ///     current delivery (or the flush timer) hands on next. Deliveries never run on the reporting
+        ///     thread, so a slow subscriber does not hold up the producer and its reports keep coalescing.
+        /// </summary>
+        template <typename ProgressType>
+        class progress_coalescer : public std::enable_shared_from_this<progress_coalescer<ProgressType>>
+        {
+            typedef std::chrono::steady_clock clock_type;
+
+            progress_coalescing<ProgressType> m_policy;
+            std::function<void (ProgressType)> m_deliver;
+            std::mutex m_lock;
+            bool m_hasPending;
+            bool m_busy;
+            ProgressType m_pending;
+            clock_type::time_point m_lastDelivery;
+
+            // Caller must hold m_lock.
+            std::chrono::milliseconds delay() const
+            {
+                auto due = m_lastDelivery + m_policy.interval();
+                auto now = clock_type::now();
+                return due > now ? std::chrono::duration_cast<std::chrono::milliseconds>(due - now) + std::chrono::milliseconds(1) : std::chrono::milliseconds::zero();
+            }
+
+            void schedule(std::chrono::milliseconds wait)
+            {
+                auto self = this->shared_from_this();
+                timer_pool_t().queue_timer_callback(wait, [self](bool) {
+                    // Never deliver on the timer thread, a subscriber may take a while to marshal.
+                    self->post();
+                });
+            }
+
+            void post()
+            {
+                auto self = this->shared_from_this();
+                concurrency::create_task([self] { self->drain(); });
+            }
+
+            void drain()
+            {
+                for (;;)
+                {
+                    ProgressType value;
+                    {
+                        std::lock_guard<std::mutex> scopedLock(m_lock);
+                        if (!m_hasPending)
+                        {
+                            m_busy = false;
+                            return;
+                        }
+                        auto wait = delay();
+                        if (wait > std::chrono::milliseconds::zero())
+                        {
+                            schedule(wait);
+                            return;
+                        }
+                        value = m_pending;
+                        m_hasPending = false;
+                        m_lastDelivery = clock_type::now();
+                    }
+                    try
+                    {
+                        m_deliver(value);
+                    }
+                    catch (...)
+                    {
+                        // A throwing subscriber loses this report only; the loop still owns m_busy and
+                        // must go on, or every later report would queue behind a drain that never runs.
+                    }
+                }
+            }
+
+        public:
+            progress_coalescer(progress_coalescing<ProgressType> policy, std::function<void (ProgressType)> deliver) :
+                m_policy(policy), m_deliver(deliver), m_hasPending(false), m_busy(false), m_pending(), m_lastDelivery()
+            {
+            }
+
+            void report(ProgressType progress)
+            {
+                {
+                    std::lock_guard<std::mutex> scopedLock(m_lock);
+                    m_pending = m_hasPending && m_policy.combine() ? m_policy.combine()(m_pending, progress) : progress;
+                    m_hasPending = true;
+                    if (m_busy)
+                        return;
+                    m_busy = true;
+                }
+                post();
+            }
+        };
+    } // namespace details
+
 #ifdef __cplusplus_winrt
     /// <summary>
     ///     a <c>concurrency::task<ResultType></c> class with progress reporter feature.
@@ -216,28 +456,49 @@ namespace pplpp
 
         class ProgressEvent
         {
-            std::vector<std::function<void (ProgressType)>> m_callbacks;
-            std::mutex m_lock;
+            typedef std::vector<std::function<void (ProgressType)>> callback_list;
+
+            // Copy-on-write subscriber list: firing takes a snapshot and calls it without holding any lock,
+            // so a slow subscriber (marshaling to an STA) neither stalls other producers nor blocks registration.
+            // Registration is rare; it copies the list under m_writeLock and publishes the copy atomically.
+            std::shared_ptr<const callback_list> m_callbacks;
+            std::mutex m_writeLock;
 
         public:
+            ProgressEvent() :
+                m_callbacks(std::make_shared<callback_list>())
+            {
+            }
+
             void _FireProgress(ProgressType progress)
             {
-                std::unique_lock<std::mutex> scopedLock(m_lock);
-                for (size_t i = 0; i < m_callbacks.size(); i++)
-                    m_callbacks[i](progress);
+                auto callbacks = std::atomic_load(&m_callbacks);
+                for (size_t i = 0; i < callbacks->size(); i++)
+                    (*callbacks)[i](progress);
             }
 
-            void registerCallback(std::function<void (ProgressType)> callback)
+            void registerCallback(std::function<void (ProgressType)> callback, progress_coalescing<ProgressType> policy)
             {
                 details::ContextCallback context;
                 context.capture();
-                std::unique_lock<std::mutex> scopedLock(m_lock);
 
-                m_callbacks.push_back([context, callback](ProgressType progress) {
+                std::function<void (ProgressType)> deliver = [context, callback](ProgressType progress) {
                     context.callInContext([&] {
                         callback(progress);
                     });
-                });
+                };
+                if (policy.enabled())
+                {
+                    auto coalescer = std::make_shared<details::progress_coalescer<ProgressType>>(policy, deliver);
+                    deliver = [coalescer](ProgressType progress) {
+                        coalescer->report(progress);
+                    };
+                }
+
+                std::lock_guard<std::mutex> scopedLock(m_writeLock);
+                auto callbacks = std::make_shared<callback_list>(*std::atomic_load(&m_callbacks));
+                callbacks->push_back(deliver);
+                std::atomic_store(&m_callbacks, std::shared_ptr<const callback_list>(callbacks));
             }
         };
 
@@ -256,13 +517,16 @@ namespace pplpp
         ///     The callback functor which will be invoked each time progress fired.
         ///     The signature of this functor must be <c>void (ProgressType)</c>.
         /// </param>
+        /// <param name="policy">
+        ///     How reports are coalesced before they reach this subscriber; every report by default.
+        /// </param>
         /// <remarks>
         ///     The callback function will be called the same apartment as <c>on_progress</c> called.
         ///     This function could be invoked multiple times to make multiple subscriptions.
         /// </remarks>
-        void on_progress(std::function<void (ProgressType)> callback)
+        void on_progress(std::function<void (ProgressType)> callback, progress_coalescing<ProgressType> policy = progress_coalescing<ProgressType>::every())
         {
-            m_progressEvent->registerCallback(callback);
+            m_progressEvent->registerCallback(callback, policy);
         }
 
         /// <summary>
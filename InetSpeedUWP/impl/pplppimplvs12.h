@@ -28,9 +28,14 @@
 #pragma once
 
 #include <tuple>
+#include <utility>
 #include <ppl.h>
 #include <atomic>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
 #include <type_traits>
+#include <vector>
 namespace pplpp
 {
     namespace details
@@ -48,6 +53,71 @@ namespace pplpp
             size_t total;
         };
 
+        /// <summary>
+        ///     The one block shared by every continuation of a range-based when_all / when_any / when_n.
+        ///     Continuations capture a single pointer to it; it holds only what the result needs (the tasks
+        ///     for when_all, the completion order for when_n, nothing for when_any).
+        /// </summary>
+        template<typename ResultType>
+        struct RangeData
+        {
+            RangeData(size_t r)
+                : counter(0), written(0), required(r), result()
+            {
+            }
+
+            std::atomic_size_t counter;
+            std::atomic_size_t written;
+            size_t required;
+            ResultType result;
+            concurrency::task_completion_event<ResultType> tce;
+        };
+
+        template<typename Ty>
+        struct FirstSuccessData
+        {
+            FirstSuccessData(size_t t, concurrency::cancellation_token_source c)
+                : remaining(t), done(false), losers(c)
+            {
+            }
+
+            std::atomic_size_t remaining;
+            std::atomic_bool done;
+            std::mutex lock;
+            std::exception_ptr lastError;
+            concurrency::cancellation_token_source losers;
+            concurrency::task_completion_event<Ty> tce;
+        };
+
+        template<typename Ty>
+        struct FirstSuccess
+        {
+            // Throws if the task failed.
+            static void complete(const std::shared_ptr<FirstSuccessData<Ty>>& data, const concurrency::task<Ty>& finished)
+            {
+                auto result = finished.get();
+                if (!data->done.exchange(true))
+                {
+                    data->losers.cancel();
+                    data->tce.set(result);
+                }
+            }
+        };
+
+        template<>
+        struct FirstSuccess<void>
+        {
+            static void complete(const std::shared_ptr<FirstSuccessData<void>>& data, const concurrency::task<void>& finished)
+            {
+                finished.get();
+                if (!data->done.exchange(true))
+                {
+                    data->losers.cancel();
+                    data->tce.set();
+                }
+            }
+        };
+
         template<typename TupleType, size_t N>
         struct when_all_iterator
         {
@@ -103,29 +173,6 @@ namespace pplpp
         };
 
 
-        template<typename Tuple, std::size_t N>
-        struct tuple_taskGen
-        {
-            template<typename T>
-            static auto taskGen(const Tuple& t, const T& resultTuple)
-                ->decltype(tuple_taskGen<Tuple, N - 1>::taskGen(t, std::tuple_cat(std::make_tuple(perform(std::get<N>(t))), resultTuple)))
-            {
-                auto tempTuple = std::tuple_cat(std::make_tuple(perform(std::get<N>(t))), resultTuple);
-                return tuple_taskGen<Tuple, N - 1>::taskGen(t, tempTuple);
-            }
-        };
-        template<typename Tuple>
-        struct tuple_taskGen<Tuple, -1>
-        {
-            template<typename T>
-            static T taskGen(const Tuple& t, const T& resultTuple)
-            {
-                (t);
-                return resultTuple;
-            }
-        };
-
-
         template<typename T>
         concurrency::task<T> perform(const T& t)
         {
@@ -166,68 +213,47 @@ namespace pplpp
 
 #endif /* defined (__cplusplus_winrt) */
 
-        //tuple unwrapper
-        template<typename Tuple, std::size_t N>
-        struct tuple_unwrapper
-        {
-            template<typename T>
-            static auto unwrapping(const Tuple& t, const T& resultTuple)
-                ->decltype(tuple_unwrapper<Tuple, N - 1>::unwrapping(t, std::tuple_cat(std::make_tuple(std::get<N>(t).get()), resultTuple)))
-            {
-                auto tempTuple = std::tuple_cat(std::make_tuple(std::get<N>(t).get()), resultTuple);
-                return tuple_unwrapper<Tuple, N - 1>::unwrapping(t, tempTuple);
-            }
-        };
-        template<typename Tuple>
-        struct tuple_unwrapper<Tuple, -1>
-        {
-            template<typename T>
-            static T unwrapping(const Tuple& t, const T& resultTuple)
-            {
-                (t);
-                return resultTuple;
-            }
-        };
+        // The helpers below expand the tuple's index_sequence in a single pack expansion, so every element is
+        // converted (and the result tuple built) in one pass, without an intermediate tuple_cat per element.
 
-        //get the return type
-        template<typename Tuple, std::size_t N>
-        struct getUnwrapperReturnType
+        //tuple of tasks from a tuple of values, tasks and async operations
+        template<typename Tuple, std::size_t... I>
+        auto tuple_taskGen(const Tuple& t, std::index_sequence<I...>)
+            ->decltype(std::make_tuple(perform(std::get<I>(t))...))
         {
-            template<typename T>
-            static auto  get(const Tuple& t, const T& resultTuple)
-                ->decltype(getUnwrapperReturnType<Tuple, N - 1>::get(t, std::tuple_cat(std::make_tuple(std::tuple_element<N, Tuple>::type::result_type()), resultTuple)))
-            {
-                auto e = std::tuple_element<N, Tuple>::type::result_type();
-                auto t2 = std::tuple_cat(std::make_tuple(e), resultTuple);
+            return std::make_tuple(perform(std::get<I>(t))...);
+        }
 
-                return getUnwrapperReturnType<Tuple, N - 1>::get(t, t2);
-            }
-        };
-        template<typename Tuple>
-        struct getUnwrapperReturnType<Tuple, -1>
+        //result type of unwrapping a tuple of tasks
+        template<typename TupleTask>
+        struct unwrapped_tuple;
+
+        template<typename... T>
+        struct unwrapped_tuple<std::tuple<concurrency::task<T>...>>
         {
-            template<typename T>
-            static T get(const Tuple& t, const T& resultTuple)
-            {
-                return resultTuple;
-            }
+            typedef std::tuple<T...> type;
         };
 
+        //tuple unwrapper, every result is read with get() straight into its slot; get() returns a copy of the
+        //task's stored result, so there is nothing to move from
+        template<typename TupleTask, std::size_t... I>
+        typename unwrapped_tuple<TupleTask>::type tuple_unwrapper(const TupleTask& t, std::index_sequence<I...>)
+        {
+            return typename unwrapped_tuple<TupleTask>::type(std::get<I>(t).get()...);
+        }
+
         template<typename TypeInputTuple>
         auto unwrappingTupleHelper(const TypeInputTuple& inputTuple)
-            ->concurrency::task < decltype(getUnwrapperReturnType<decltype(tuple_taskGen<TypeInputTuple, std::tuple_size<TypeInputTuple>::value - 1>::taskGen(inputTuple, std::tuple<>())),
-            std::tuple_size<decltype(tuple_taskGen<TypeInputTuple, std::tuple_size<TypeInputTuple>::value - 1>::taskGen(inputTuple, std::tuple<>()))>::value - 1>::get(tuple_taskGen<TypeInputTuple,
-            std::tuple_size<TypeInputTuple>::value - 1>::taskGen(inputTuple, std::tuple<>()), std::tuple<>())) >
+            ->concurrency::task<typename unwrapped_tuple<decltype(tuple_taskGen(inputTuple, std::make_index_sequence<std::tuple_size<TypeInputTuple>::value>()))>::type>
         {
-            auto tupleTask = tuple_taskGen<TypeInputTuple, std::tuple_size<TypeInputTuple>::value - 1>::taskGen(inputTuple, std::tuple<>());    //tuple of tasks
+            typedef std::make_index_sequence<std::tuple_size<TypeInputTuple>::value> Indices;
+            auto tupleTask = tuple_taskGen(inputTuple, Indices());    //tuple of tasks
             auto task_tupleTask = pplpp::when_all(tupleTask);    //task of tuple of tasks
 
             typedef decltype(tupleTask) TypeTupleTask;
-            auto returnTask = task_tupleTask.then([](TypeTupleTask _tuple){
-                return tuple_unwrapper<TypeTupleTask, std::tuple_size<TypeTupleTask>::value - 1>::unwrapping(_tuple, std::tuple<>());
+            return task_tupleTask.then([](TypeTupleTask _tuple){
+                return tuple_unwrapper(_tuple, Indices());
             });
-
-            return returnTask;
         }
 
         template <typename Func>
@@ -377,6 +403,156 @@ namespace pplpp
         return concurrency::create_task(data->tce);
     }
 
+    /// <summary>
+    ///     Creates a task that will complete when all of the homogeneous tasks in a range complete.
+    /// </summary>
+    /// <param name="tasks">
+    ///     The tasks to wait for; their number only needs to be known at runtime.
+    /// </param>
+    /// <returns>
+    ///     A task that completes when every input task has completed, successfully or not, with the input tasks
+    ///     as its result so each one can be inspected with <c>get()</c>.
+    ///	</return>
+    template <typename Ty>
+    concurrency::task<std::vector<concurrency::task<Ty>>> when_all(const std::vector<concurrency::task<Ty>>& tasks)
+    {
+        if (tasks.empty())
+            return concurrency::task_from_result(tasks);
+
+        auto data = std::make_shared<details::RangeData<std::vector<concurrency::task<Ty>>>>(tasks.size());
+        data->result = tasks;
+        for (auto& current_task : tasks)
+        {
+            current_task.then([data](concurrency::task<Ty>) {
+                if (++(data->counter) == data->required)
+                    data->tce.set(data->result);
+            });
+        }
+
+        return concurrency::create_task(data->tce);
+    }
+
+    /// <summary>
+    ///     Creates a task that will complete when the first <paramref name="count"/> of the homogeneous tasks in a range complete.
+    /// </summary>
+    /// <param name="tasks">
+    ///     The tasks to wait for.
+    /// </param>
+    /// <param name="count">
+    ///     How many of them must complete (a quorum), at most <c>tasks.size()</c>.
+    /// </param>
+    /// <returns>
+    ///     A task whose result holds the indexes of the first <paramref name="count"/> tasks to complete, in completion order.
+    ///	</return>
+    /// <remarks>
+    ///     A task that completes with an exception counts toward the quorum like any other; call <c>get()</c> on it to find out.
+    ///     Throws <c>std::invalid_argument</c> if <paramref name="count"/> exceeds the number of tasks.
+    /// </remarks>
+    template <typename Ty>
+    concurrency::task<std::vector<size_t>> when_n(const std::vector<concurrency::task<Ty>>& tasks, size_t count)
+    {
+        if (count > tasks.size())
+            throw std::invalid_argument("when_n: count exceeds the number of tasks");
+        if (count == 0)
+            return concurrency::task_from_result(std::vector<size_t>());
+
+        auto data = std::make_shared<details::RangeData<std::vector<size_t>>>(count);
+        data->result.resize(count);
+        for (size_t i = 0; i < tasks.size(); i++)
+        {
+            tasks[i].then([data, i](concurrency::task<Ty>) {
+                auto slot = data->counter++;
+                if (slot >= data->required)
+                    return;
+
+                // Only the completions that made the quorum write a slot; whichever write is the last one publishes.
+                data->result[slot] = i;
+                if (++(data->written) == data->required)
+                    data->tce.set(data->result);
+            });
+        }
+
+        return concurrency::create_task(data->tce);
+    }
+
+    /// <summary>
+    ///     Creates a task that will complete when any of the homogeneous tasks in a range completes.
+    /// </summary>
+    /// <param name="tasks">
+    ///     The tasks to wait for; must not be empty.
+    /// </param>
+    /// <returns>
+    ///     A task whose result is the index of the first task to complete.
+    ///	</return>
+    /// <remarks>
+    ///     The first task to complete wins even if it completed with an exception.
+    ///     Throws <c>std::invalid_argument</c> if <paramref name="tasks"/> is empty.
+    /// </remarks>
+    template <typename Ty>
+    concurrency::task<size_t> when_any(const std::vector<concurrency::task<Ty>>& tasks)
+    {
+        if (tasks.empty())
+            throw std::invalid_argument("when_any: no tasks");
+
+        auto data = std::make_shared<details::RangeData<size_t>>(1);
+        for (size_t i = 0; i < tasks.size(); i++)
+        {
+            tasks[i].then([data, i](concurrency::task<Ty>) {
+                if (data->counter++ == 0)
+                    data->tce.set(i);
+            });
+        }
+
+        return concurrency::create_task(data->tce);
+    }
+
+    /// <summary>
+    ///     Creates a task that completes with the result of the first task in a range to complete successfully.
+    /// </summary>
+    /// <param name="tasks">
+    ///     The competing tasks; must not be empty.
+    /// </param>
+    /// <param name="losers">
+    ///     Canceled as soon as a task succeeds. Create the competing tasks with its token so the losers
+    ///     (and whatever sockets they hold) are torn down right away instead of running to completion.
+    /// </param>
+    /// <returns>
+    ///     A task with the first successful result. If every task fails or is canceled, it fails with the
+    ///     exception of the last one to finish.
+    ///	</return>
+    /// <remarks>
+    ///     Unlike <c>when_any</c>, a task that fails fast does not win the race.
+    ///     Throws <c>std::invalid_argument</c> if <paramref name="tasks"/> is empty.
+    /// </remarks>
+    template <typename Ty>
+    concurrency::task<Ty> when_first_success(const std::vector<concurrency::task<Ty>>& tasks, concurrency::cancellation_token_source losers)
+    {
+        if (tasks.empty())
+            throw std::invalid_argument("when_first_success: no tasks");
+
+        auto data = std::make_shared<details::FirstSuccessData<Ty>>(tasks.size(), losers);
+        for (auto& current_task : tasks)
+        {
+            current_task.then([data](concurrency::task<Ty> finished) {
+                try {
+                    details::FirstSuccess<Ty>::complete(data, finished);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> scopedLock(data->lock);
+                    data->lastError = std::current_exception();
+                }
+
+                if (--(data->remaining) == 0 && !data->done.exchange(true))
+                {
+                    std::lock_guard<std::mutex> scopedLock(data->lock);
+                    data->tce.set_exception(data->lastError);
+                }
+            });
+        }
+
+        return concurrency::create_task(data->tce);
+    }
+
     /// <summary>
     ///     Create a functor that unwrapes the return tuple of the input functor.
     ///     We can use this function to pass data in task continuation.
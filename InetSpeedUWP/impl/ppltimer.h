@@ -26,12 +26,17 @@
 ****/
 
 #pragma once
-#include <agents.h>
 
 #include <functional>
 #include <chrono>
 #include <memory>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <vector>
+#include <cstdint>
 #include <ppl.h>
 
 
@@ -39,63 +44,398 @@ namespace pplpp
 {
     namespace details
     {
-        class TimerPoolImpl
+        /// <summary>
+        ///     Identifies a timer queued on the <c>timing_wheel</c>. Handles are plain values; using one after
+        ///     its timer has fired or been cancelled is harmless because the generation no longer matches.
+        /// </summary>
+        struct timer_handle
+        {
+            uint32_t index;
+            uint32_t generation;
+        };
+
+        /// <summary>
+        ///     Hierarchical timing wheel that drives every pplpp timer from a single thread.
+        /// </summary>
+        /// <remarks>
+        ///     Four levels of 64 slots with a 1 ms tick cover about 4.6 hours; longer timeouts are parked in the
+        ///     top level and re-cascaded until they come due. Insert and cancel are O(1), expired timers are
+        ///     collected under the lock and fired as one batch outside of it, and timer nodes are recycled through
+        ///     a free list so steady-state scheduling does not allocate. Only the standard library and the PPL
+        ///     cancellation token are used, so the wheel does not depend on the Concurrency Runtime agents library.
+        /// </remarks>
+        class timing_wheel
         {
-            class TimerWithCallback
-            {
-                concurrency::timer<int> m_timer;
-                concurrency::call<int> m_callback;
-                std::function<void(bool)> m_userCallback;
-                concurrency::cancellation_token m_token;
-                concurrency::cancellation_token_registration m_reg;
-                std::atomic<bool> m_fired, m_constructed;
-
-            public:
-                TimerWithCallback(std::chrono::milliseconds timeout, std::function<void(bool) > callback, concurrency::cancellation_token token) : m_timer(static_cast<int>(timeout.count()), 0, NULL, false), 
-                    m_callback([this] (int) mutable { this->timerCallback(true); }), m_userCallback(callback), m_token(token), m_fired(false), m_constructed(false)
+            static const unsigned slot_bits = 6;
+            static const uint32_t slot_count = 1u << slot_bits;
+            static const uint32_t slot_mask = slot_count - 1;
+            static const unsigned level_count = 4;
+            static const uint64_t max_delta = 1ull << (slot_bits * level_count);
+            static const uint32_t npos = 0xffffffffu;
+
+            struct node
+            {
+                node() : prev(npos), next(npos), generation(0), armed(false), level(0), slot(0), expiry(0), token(concurrency::cancellation_token::none()) {}
+
+                uint32_t prev, next;
+                uint32_t generation;
+                bool armed;
+                unsigned level, slot;
+                uint64_t expiry;
+                std::function<void(bool)> callback;
+                concurrency::cancellation_token token;
+                concurrency::cancellation_token_registration registration;
+            };
+
+            struct expired_timer
+            {
+                expired_timer() : token(concurrency::cancellation_token::none()) {}
+                expired_timer(std::function<void(bool)> callback, concurrency::cancellation_token token, concurrency::cancellation_token_registration registration) :
+                    callback(std::move(callback)), token(token), registration(registration) {}
+
+                void deregister()
                 {
-                    m_timer.link_target(&m_callback);
-                    m_timer.start();
-                    if (token != concurrency::cancellation_token::none())
-                        m_reg = token.register_callback([this] ()mutable {this->timerCallback(false); });
-                    m_constructed = true;
+                    if (token != concurrency::cancellation_token::none() && registration != concurrency::cancellation_token_registration())
+                        token.deregister_callback(registration);
                 }
 
-                void timerCallback(bool firedbytimer)
+                std::function<void(bool)> callback;
+                concurrency::cancellation_token token;
+                concurrency::cancellation_token_registration registration;
+            };
+
+            std::mutex m_lock;
+            std::condition_variable m_wakeup;
+            std::deque<node> m_nodes;
+            uint32_t m_slots[level_count][slot_count];
+            uint64_t m_occupied;            // bitmap of non-empty level 0 slots
+            uint32_t m_free;
+            size_t m_armed;
+            uint64_t m_tick;
+            uint64_t m_nextWake;
+            bool m_driverStarted;
+            std::vector<expired_timer> m_batch;
+            const std::chrono::steady_clock::time_point m_epoch;
+
+            timing_wheel() : m_occupied(0), m_free(npos), m_armed(0), m_tick(0), m_nextWake(~0ull), m_driverStarted(false), m_epoch(std::chrono::steady_clock::now())
+            {
+                for (unsigned level = 0; level < level_count; level++)
+                    for (uint32_t slot = 0; slot < slot_count; slot++)
+                        m_slots[level][slot] = npos;
+            }
+
+            timing_wheel(const timing_wheel&) = delete;
+            timing_wheel& operator=(const timing_wheel&) = delete;
+
+            uint64_t now_tick() const
+            {
+                return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_epoch).count());
+            }
+
+            uint32_t allocate_node()
+            {
+                if (m_free == npos)
                 {
-                    if (m_fired.exchange(true))
-                        return;
+                    m_nodes.emplace_back();
+                    return static_cast<uint32_t>(m_nodes.size() - 1);
+                }
+                auto index = m_free;
+                m_free = m_nodes[index].next;
+                return index;
+            }
+
+            void free_node(uint32_t index)
+            {
+                node& n = m_nodes[index];
+                n.armed = false;
+                n.generation++;
+                n.prev = npos;
+                n.next = m_free;
+                m_free = index;
+            }
 
-                    if (firedbytimer)
+            void link(uint32_t index)
+            {
+                node& n = m_nodes[index];
+                uint64_t expiry = n.expiry;
+                if (expiry < m_tick)
+                    expiry = m_tick;
+                uint64_t delta = expiry - m_tick;
+                if (delta >= max_delta)
+                {
+                    // too far out for the wheel: park it in the top level, it is re-evaluated on cascade
+                    delta = max_delta - 1;
+                    expiry = m_tick + delta;
+                }
+
+                unsigned level = 0;
+                while (delta >= (1ull << (slot_bits * (level + 1))))
+                    level++;
+
+                n.level = level;
+                n.slot = static_cast<unsigned>((expiry >> (slot_bits * level)) & slot_mask);
+                n.prev = npos;
+                n.next = m_slots[level][n.slot];
+                if (n.next != npos)
+                    m_nodes[n.next].prev = index;
+                m_slots[level][n.slot] = index;
+                if (level == 0)
+                    m_occupied |= 1ull << n.slot;
+            }
+
+            void unlink(uint32_t index)
+            {
+                node& n = m_nodes[index];
+                if (n.prev != npos)
+                    m_nodes[n.prev].next = n.next;
+                else
+                    m_slots[n.level][n.slot] = n.next;
+                if (n.next != npos)
+                    m_nodes[n.next].prev = n.prev;
+                if (n.level == 0 && m_slots[0][n.slot] == npos)
+                    m_occupied &= ~(1ull << n.slot);
+            }
+
+            // Re-distributes one slot of an upper level into the levels below it.
+            uint32_t cascade(unsigned level)
+            {
+                auto slot = static_cast<uint32_t>((m_tick >> (slot_bits * level)) & slot_mask);
+                auto index = m_slots[level][slot];
+                m_slots[level][slot] = npos;
+                while (index != npos)
+                {
+                    auto next = m_nodes[index].next;
+                    link(index);
+                    index = next;
+                }
+                return slot;
+            }
+
+            // Advances the wheel by one tick, moving everything due at that tick into m_batch.
+            void advance()
+            {
+                auto slot = static_cast<uint32_t>(m_tick & slot_mask);
+                if (slot == 0)
+                {
+                    for (unsigned level = 1; level < level_count && cascade(level) == 0; level++)
+                        ;
+                }
+
+                auto index = m_slots[0][slot];
+                m_slots[0][slot] = npos;
+                m_occupied &= ~(1ull << slot);
+                while (index != npos)
+                {
+                    node& n = m_nodes[index];
+                    auto next = n.next;
+                    m_batch.emplace_back(std::move(n.callback), n.token, n.registration);
+                    n.callback = nullptr;
+                    n.token = concurrency::cancellation_token::none();
+                    free_node(index);
+                    m_armed--;
+                    index = next;
+                }
+                m_tick++;
+            }
+
+            // The next tick that needs attention: the first occupied level 0 slot, or the next cascade.
+            uint64_t next_tick() const
+            {
+                auto slot = static_cast<unsigned>(m_tick & slot_mask);
+                if (slot == 0)
+                    return m_tick; // the cascade for this tick has not run yet
+                uint64_t ahead = m_occupied >> slot;
+                if (ahead == 0)
+                    return (m_tick | slot_mask) + 1;
+                uint64_t tick = m_tick;
+                while ((ahead & 1) == 0)
+                {
+                    ahead >>= 1;
+                    tick++;
+                }
+                return tick;
+            }
+
+            void drive()
+            {
+                std::vector<expired_timer> batch;
+                std::unique_lock<std::mutex> lock(m_lock);
+                for (;;)
+                {
+                    if (m_armed == 0)
                     {
-                        if (m_token != concurrency::cancellation_token::none())
-                            m_token.deregister_callback(m_reg);
+                        m_nextWake = ~0ull;
+                        m_wakeup.wait(lock);
+                        continue;
                     }
-                    else
-                        m_timer.stop();
 
-                    struct AsyncDeletor
+                    auto now = now_tick();
+                    while (m_tick <= now && m_armed != 0)
+                        advance();
+
+                    if (!m_batch.empty())
                     {
-                        TimerWithCallback *m_target;
-                        AsyncDeletor(TimerWithCallback *target) : m_target(target) {}
-                        ~AsyncDeletor()
+                        batch.swap(m_batch);
+                        lock.unlock();
+                        for (auto& timer : batch)
                         {
-                            auto t = m_target;
-                            concurrency::create_task([=] {
-                                while (!t->m_constructed); // busy wait for constructor completion
-                                delete t;
-                            });						
+                            timer.deregister();
+                            try
+                            {
+                                timer.callback(true);
+                            }
+                            catch (...)
+                            {
+                                // a throwing callback must not take down the timer thread
+                            }
                         }
-                    } deletor(this);
+                        batch.clear();
+                        lock.lock();
+                        continue;
+                    }
 
-                    m_userCallback(firedbytimer);
+                    if (m_armed != 0)
+                    {
+                        m_nextWake = next_tick();
+                        m_wakeup.wait_until(lock, m_epoch + std::chrono::milliseconds(m_nextWake));
+                    }
                 }
-            };
+            }
+
+            // Removes an armed timer and hands back what it owned. Returns false if the timer already fired or was cancelled.
+            bool release(timer_handle handle, expired_timer& timer)
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+                if (handle.index >= m_nodes.size())
+                    return false;
+                node& n = m_nodes[handle.index];
+                if (!n.armed || n.generation != handle.generation)
+                    return false;
+
+                unlink(handle.index);
+                timer.callback = std::move(n.callback);
+                timer.token = n.token;
+                timer.registration = n.registration;
+                n.callback = nullptr;
+                n.token = concurrency::cancellation_token::none();
+                free_node(handle.index);
+                m_armed--;
+                return true;
+            }
+
+        public:
+            static timing_wheel& instance()
+            {
+                // Intentionally never destroyed: the driver thread may outlive static destruction during module unload.
+                static timing_wheel* wheel = new timing_wheel();
+                return *wheel;
+            }
+
+            /// <summary>
+            ///     Queues <paramref name="callback"/> to run after <paramref name="timeout"/>. The callback receives <c>true</c>
+            ///     when the timer expired, or <c>false</c> when <paramref name="token"/> was canceled first.
+            /// </summary>
+            timer_handle schedule(std::chrono::milliseconds timeout, std::function<void(bool)> callback, concurrency::cancellation_token token)
+            {
+                timer_handle handle;
+                {
+                    std::lock_guard<std::mutex> lock(m_lock);
+                    if (!m_driverStarted)
+                    {
+                        std::thread(&timing_wheel::drive, this).detach();
+                        m_driverStarted = true;
+                    }
+
+                    auto now = now_tick();
+                    if (m_armed == 0)
+                        m_tick = now;
+
+                    // round up so a timer never fires before its timeout has elapsed
+                    auto delay = timeout.count() > 0 ? static_cast<uint64_t>(timeout.count()) + 1 : 0;
+                    auto index = allocate_node();
+                    node& n = m_nodes[index];
+                    n.armed = true;
+                    n.expiry = now + delay;
+                    n.callback = std::move(callback);
+                    n.token = token;
+                    n.registration = concurrency::cancellation_token_registration();
+                    link(index);
+                    m_armed++;
+                    handle.index = index;
+                    handle.generation = n.generation;
+
+                    if (n.expiry < m_nextWake)
+                        m_wakeup.notify_one();
+                }
+
+                if (token != concurrency::cancellation_token::none())
+                {
+                    auto registration = token.register_callback([this, handle] {
+                        expired_timer timer;
+                        if (release(handle, timer))
+                            timer.callback(false);
+                    });
+
+                    bool stored = false;
+                    {
+                        std::lock_guard<std::mutex> lock(m_lock);
+                        node& n = m_nodes[handle.index];
+                        if (n.armed && n.generation == handle.generation)
+                        {
+                            n.registration = registration;
+                            stored = true;
+                        }
+                    }
+                    if (!stored)
+                        expired_timer(nullptr, token, registration).deregister();
+                }
+                return handle;
+            }
+
+            /// <summary>
+            ///     Number of timers currently armed on the wheel.
+            /// </summary>
+            size_t live_count()
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+                return m_armed;
+            }
+
+            /// <summary>
+            ///     Disarms a queued timer without invoking its callback.
+            /// </summary>
+            /// <returns>
+            ///     <c>true</c> if the timer was still armed; <c>false</c> if it already fired or was cancelled.
+            /// </returns>
+            bool cancel(timer_handle handle)
+            {
+                expired_timer timer;
+                if (!release(handle, timer))
+                    return false;
+                timer.deregister();
+                return true;
+            }
+        };
+
+        class TimerPoolImpl
+        {
         public:
-            void queue_timer_callback(std::chrono::milliseconds timeout, std::function<void(bool)> callback, concurrency::cancellation_token token = concurrency::cancellation_token::none())
+            timer_handle queue_timer_callback(std::chrono::milliseconds timeout, std::function<void(bool)> callback, concurrency::cancellation_token token = concurrency::cancellation_token::none())
+            {
+                return timing_wheel::instance().schedule(timeout, std::move(callback), token);
+            }
+
+            bool cancel_timer(timer_handle handle)
+            {
+                return timing_wheel::instance().cancel(handle);
+            }
+
+            /// <summary>
+            ///     Returns how many timers are queued and have neither fired nor been cancelled.
+            /// </summary>
+            static size_t live_timers()
             {
-                // Memory will be cleand by itself
-                new TimerWithCallback(timeout, callback, token);
+                return timing_wheel::instance().live_count();
             }
         };
     }
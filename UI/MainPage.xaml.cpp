@@ -44,4 +44,44 @@ void MainPage::SpeedButton_Click(Platform::Object^ sender, Windows::UI::Xaml::Ro
 	{
 		TextBoxResults->Text = "Not connected...";
 	}
+}
+
+void MainPage::UdpLoopbackButton_Click(Platform::Object^ sender, Windows::UI::Xaml::RoutedEventArgs^ e)
+{
+	//Reflect UDP probes in-process with 10% injected loss and enough jitter to reorder some of them, drawn from a
+	//fixed seed so the check sees the same drops on every run...
+	auto server = ref new ReflectorServer();
+	server->DropRate = 0.1;
+	server->JitterMilliseconds = 15;
+	server->Seed = 20151;
+
+	create_task(server->StartAsync("")).then([server]
+	{
+		if (!server->ReflectsUdp)
+		{
+			cancel_current_task();
+		}
+		return create_task(InternetConnectionState::GetUdpProbeAsync(ref new Windows::Networking::HostName("127.0.0.1"), server->ServiceName, 200));
+	}).then([this, server](task<UdpProbeResult^> probed)
+	{
+		server->Stop();
+		try
+		{
+			auto result = probed.get();
+			//200 probes at 10% loss stay within 3% to 17% loss all but very rarely...
+			auto passed = result->SentCount == 200 && result->LossRate > 0.03 && result->LossRate < 0.17 && result->Median > 0.0;
+			auto verdict = ref new String(passed ? L"UDP loopback check passed: " : L"UDP loopback check FAILED: ");
+			TextBoxResults->Text += verdict +
+				"sent " + result->SentCount + ", received " + result->ReceivedCount + ", loss " + result->LossRate +
+				", reordered " + result->ReorderedCount + ", median RTT " + result->Median + "\n";
+		}
+		catch (Platform::Exception^ ex)
+		{
+			TextBoxResults->Text += "UDP loopback check FAILED: " + ex->Message + "\n";
+		}
+		catch (task_canceled&)
+		{
+			TextBoxResults->Text += "UDP loopback check FAILED: the reflector could not bind its UDP port\n";
+		}
+	}, task_continuation_context::use_current());
 }
\ No newline at end of file
@@ -22,6 +22,7 @@ namespace UI
 		MainPage();
 	private:
 		void SpeedButton_Click(Platform::Object^ sender, Windows::UI::Xaml::RoutedEventArgs^ e);
+		void UdpLoopbackButton_Click(Platform::Object^ sender, Windows::UI::Xaml::RoutedEventArgs^ e);
 		ConnectionSpeed __speed;
 	};
 }